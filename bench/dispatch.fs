@@ -0,0 +1,9 @@
+\ A loop of small primitives, bound by dispatch, to compare dispatch strategies.
+\ Usage: llforth bench/dispatch.fs, or `make bench-dispatch` for branch misses of both builds
+
+: mix dup 3 * swap over + swap - 1+ ;
+: work 0 swap 0 do mix i + loop ;
+
+." dispatch: " utime 1000000 work drop utime swap - . ." us" cr
+
+bye
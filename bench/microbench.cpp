@@ -0,0 +1,189 @@
+// Dispatch costs of single primitives and common pairs, to judge changes to the code llforthc
+// generates. Every benchmark is a colon word, compiled by the embedded VM itself, which repeats
+// a short sequence of words between a setup and a cleanup; the same word without the sequence
+// is measured too and subtracted, which leaves the cost of the dispatches in the sequence.
+// Instructions and branch misses come from perf_event_open. Where the hardware counters are not
+// available, e.g. in a VM or with a restrictive perf_event_paranoid, those columns show CPU time
+// from the task clock instead, and from clock_gettime where perf_event_open is denied or absent.
+// Usage: llforth-microbench [FILTER], or `make bench-micro`
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+enum { PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES };
+#endif
+
+#include "llforth.h"
+
+struct Benchmark {
+    const char* name;
+    const char* setup;    // Leaves what the sequence needs on the stack
+    const char* sequence; // Must leave the stack as it found it
+    const char* cleanup;
+    int dispatches;       // Per sequence
+};
+
+static const Benchmark Benchmarks[] = {
+    {"swap",           "0 0", "swap",       "drop drop", 1},
+    {"dup drop",       "0",   "dup drop",   "drop",      2},
+    {"lit +",          "0",   "1 +",        "drop",      2},
+    {">r r>",          "0",   ">r r>",      "drop",      2},
+    {"docol exit",     "",    "nop",        "",          2},
+    {"0branch taken",  "",    "0 if then",  "",          2},
+    {"0branch skip",   "",    "-1 if then", "",          2},
+};
+
+// Sequences per word, bound by the 1024 cells of dict_memory, and calls per measurement
+const static int Repeats = 100;
+const static int Calls = 20000;
+const static int Trials = 5;
+
+static double CpuNow() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// Counts the hardware event config, or else CPU time in ns
+class Counter {
+public:
+#ifdef __linux__
+    Counter(const char* name, uint64_t config): name(name) {
+        fd = Open(PERF_TYPE_HARDWARE, config);
+        if (fd < 0) {
+            fd = Open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+            this->name = "cpu-ns";
+        }
+    }
+    ~Counter() { if (fd >= 0) { close(fd); } }
+    void Start() {
+        if (fd < 0) {
+            start = CpuNow();
+            return;
+        }
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    double Stop() {
+        uint64_t value = 0;
+        if (fd < 0) { return CpuNow() - start; }
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &value, sizeof(value)) != sizeof(value)) { return 0; }
+        return (double)value;
+    }
+#else
+    Counter(const char*, uint64_t) {}
+    void Start() { start = CpuNow(); }
+    double Stop() { return CpuNow() - start; }
+#endif
+    std::string Column() const { return std::string(name) + "/disp"; }
+
+private:
+#ifdef __linux__
+    static int Open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = type;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+    const char* name = "cpu-ns";
+    int fd = -1;
+    double start = 0;
+};
+
+struct Sample {
+    double ns;
+    double instructions;
+    double branch_misses;
+};
+
+static double Now() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static void Eval(llforth_vm* vm, const std::string& source) {
+    auto code = llforth_eval(vm, source.data(), source.size());
+    if (code != 0) {
+        fprintf(stderr, "throw %lld in: %s\n", (long long)code, source.c_str());
+        exit(1);
+    }
+}
+
+// The best of Trials runs of the benchmark word, with or without its sequence
+static Sample Measure(llforth_vm* vm, Counter& instructions, Counter& branch_misses,
+                      const Benchmark& benchmark, bool with_sequence) {
+    std::string source = "marker bench-end : bench ";
+    source += benchmark.setup;
+    for (int i = 0; with_sequence && i < Repeats; i++) {
+        source += " ";
+        source += benchmark.sequence;
+    }
+    source += " ";
+    source += benchmark.cleanup;
+    source += " ;";
+    Eval(vm, source);
+    auto xt = llforth_find(vm, "bench", 5);
+    llforth_call(vm, xt);
+
+    Sample best = {1e300, 1e300, 1e300};
+    for (int trial = 0; trial < Trials; trial++) {
+        instructions.Start();
+        branch_misses.Start();
+        auto start = Now();
+        for (int i = 0; i < Calls; i++) { llforth_call(vm, xt); }
+        auto ns = Now() - start;
+        best.branch_misses = std::min(best.branch_misses, branch_misses.Stop());
+        best.instructions = std::min(best.instructions, instructions.Stop());
+        best.ns = std::min(best.ns, ns);
+    }
+    Eval(vm, "bench-end");
+    return best;
+}
+
+static void Print(double value) {
+    printf(" %12.2f", value);
+}
+
+int main(int argc, char** argv) {
+    auto filter = argc > 1 ? argv[1] : nullptr;
+    auto vm = llforth_create();
+    if (!vm) {
+        fprintf(stderr, "cannot create the VM\n");
+        return 1;
+    }
+    Eval(vm, ": nop ;");
+
+    Counter instructions("insns", PERF_COUNT_HW_INSTRUCTIONS);
+    Counter branch_misses("misses", PERF_COUNT_HW_BRANCH_MISSES);
+    printf("%-20s %12s %12s %12s\n", "benchmark", "ns/disp", instructions.Column().c_str(), branch_misses.Column().c_str());
+    for (const auto& benchmark: Benchmarks) {
+        if (filter && !strstr(benchmark.name, filter)) { continue; }
+        auto base = Measure(vm, instructions, branch_misses, benchmark, false);
+        auto full = Measure(vm, instructions, branch_misses, benchmark, true);
+        double dispatches = (double)Calls * Repeats * benchmark.dispatches;
+        printf("%-20s", benchmark.name);
+        Print((full.ns - base.ns) / dispatches);
+        Print((full.instructions - base.instructions) / dispatches);
+        Print((full.branch_misses - base.branch_misses) / dispatches);
+        printf("\n");
+    }
+    llforth_destroy(vm);
+    return 0;
+}
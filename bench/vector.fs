@@ -0,0 +1,15 @@
+\ Compares the native array words with the equivalent Forth loops.
+\ Usage: llforth bench/vector.fs
+
+: fill 0 do i , loop ;
+: forth-sum 0 swap 0 do over i 8 * + @ + loop swap drop ;
+
+: bench-forth-sum 0 do 2dup forth-sum drop loop 2drop ;
+: bench-native-sum 0 do 2dup vsum drop loop 2drop ;
+
+here@ 256 fill
+
+." forth-sum:  " dup 256 forth-sum . utime over 256 10000 bench-forth-sum utime swap - . ." us" cr
+." vsum:       " dup 256 vsum . utime over 256 10000 bench-native-sum utime swap - . ." us" cr
+
+bye
@@ -0,0 +1,81 @@
+#ifndef LLFORTH_BUDGET_H
+#define LLFORTH_BUDGET_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "stack.h"
+
+// A dispatch budget for untrusted scripts with `llforthc --budget`. Every loop goes through a
+// backward branch and every recursion through docol, so only those two count it down, instead
+// of every dispatch in next. A budget of N allows N of them; the one after throws Exhausted
+// with pc saved in budget_pc and the stacks as they are, and an embedded host can then give it
+// a new budget and resume it (see embed.h). The budget comes from $LLFORTH_BUDGET, or
+// llforth_set_budget when embedded. 0 means no limit and is kept as Unlimited, so a budget
+// which ran out stays below 0 and every later check throws again until the host sets a new one.
+namespace budget {
+    const static int64_t Exhausted = -257;
+    const static int64_t Unlimited = INT64_MAX;
+    static bool Enabled = false;
+
+    static Constant* Budget;
+    static Constant* ResumePC;
+    static BasicBlock* ExhaustedBlock;
+
+    const static core::Func EnvFunc {
+        "budget_from_env", FunctionType::get(core::IntType, {}, false)
+    };
+    const static core::Func SetFunc {
+        "llforth_set_budget", FunctionType::get(core::VoidType, {core::IntType}, false)
+    };
+
+    static Value* CreateLimit(Value* budget) {
+        auto is_unlimited = core::Builder.CreateICmpEQ(budget, core::GetInt(0));
+        return core::Builder.CreateSelect(is_unlimited, core::GetInt(Unlimited), budget);
+    }
+
+    // Counts down when is_counted, or always without it, then continues in next
+    static void CreateCheck(const std::string& name, Value* is_counted=nullptr) {
+        if (!Enabled) {
+            engine::CreateBrNext();
+            return;
+        }
+        auto next = core::CreateBasicBlock(name + "_budget", engine::MainFunction);
+        auto budget = core::Builder.CreateLoad(Budget);
+        auto left = core::Builder.CreateSub(budget, core::GetInt(1));
+        Value* is_out = core::Builder.CreateICmpSLT(left, core::GetInt(0));
+        if (is_counted) {
+            left = core::Builder.CreateSelect(is_counted, left, budget);
+            is_out = core::Builder.CreateAnd(is_counted, is_out);
+        }
+        core::Builder.CreateStore(left, Budget);
+        core::Builder.CreateCondBr(is_out, ExhaustedBlock, next);
+        core::Builder.SetInsertPoint(next);
+        engine::CreateBrNext();
+    }
+
+    static void Finalize() {
+        core::Builder.SetInsertPoint(ExhaustedBlock);
+        core::Builder.CreateStore(core::Builder.CreateLoad(engine::PC), ResumePC);
+        stack::Push(core::GetInt(Exhausted));
+        core::Builder.CreateBr(dict::Dictionary.at("throw").block);
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        Budget = core::CreateGlobalVariable("budget", core::IntType, core::GetInt(Unlimited), false);
+        ResumePC = core::CreateGlobalVariable("budget_pc", dict::CodePtrType, Constant::getNullValue(dict::CodePtrType), false);
+        if (engine::Embed) {
+            core::CreateFunction(SetFunc, [](Function* f, BasicBlock* entry){
+                core::Builder.CreateStore(CreateLimit(f->arg_begin()), Budget);
+                core::Builder.CreateRetVoid();
+            });
+        }
+        if (!Enabled) { return; }
+        ExhaustedBlock = core::CreateBasicBlock("budget_exhausted", main);
+        core::Builder.SetInsertPoint(entry);
+        if (!engine::Embed) { core::Builder.CreateStore(CreateLimit(core::CallFunction(EnvFunc)), Budget); }
+        engine::Finalizers.push_back(Finalize);
+    }
+}
+
+#endif //LLFORTH_BUDGET_H
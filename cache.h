@@ -0,0 +1,112 @@
+#ifndef LLFORTH_CACHE_H
+#define LLFORTH_CACHE_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "util.h"
+
+// The compiled include cache. include interprets a source file once, then saves the cells,
+// words and strings it added to the dictionary next to it as FILE.cache, and later runs load
+// them from there while the file and the interpreter stay the same. include_image tells the
+// Rust side (lib/src/cache.rs) where the dictionary tables are; it relocates every cell by
+// its kind in dict_kinds, so a cache loads wherever the dictionary ends.
+namespace cache {
+    const static core::Func BeginFunc {
+        "include_begin", FunctionType::get(core::IntType, {core::PtrType, core::PtrType, core::StrType, core::IntType}, false)
+    };
+    const static core::Func EndFunc {
+        "include_end", FunctionType::get(core::VoidType, {core::PtrType}, false)
+    };
+
+    // Must match Image in lib/src/cache.rs
+    static StructType* CreateImageType() {
+        auto image_type = StructType::create(core::TheContext, "include_image");
+        image_type->setBody({
+            core::StrType,                        // dict_memory
+            core::StrType,                        // dict_kinds
+            core::IndexType->getPointerTo(),      // here
+            core::IntType,                        // Cells of dict_memory
+            core::IntType,                        // Bytes of a cell
+            core::IntPtrType,                     // literal_pool, null without tokens
+            core::StrType,                        // pool_kinds
+            core::IndexType->getPointerTo(),      // pool_count
+            core::IntType,                        // Entries of literal_pool
+            dict::XtPtrType,                      // xts
+            dict::HeaderPtrType,                  // headers
+            core::IndexType->getPointerTo(),      // word_count
+            dict::XtPtrPtrType,                   // last_xt
+            core::IntType,                        // Entries of xts and headers
+            dict::XtPtrPtrType,                   // find_cache
+            core::IntType,                        // Entries of find_cache
+            core::StrType,                        // dict_strings
+            core::IntPtrType,                     // strings_here
+            core::IntType,                        // Bytes of dict_strings
+            dict::AddressType,                    // docol, the implementation of every word include creates
+            core::IntType,                        // Version of the dictionary layout
+            core::IndexType->getPointerTo(),      // fence, the words compiled by llforthc
+        });
+        return image_type;
+    }
+    const static auto ImageType = CreateImageType();
+
+    static Constant* Image;
+    static BlockAddress* Docol;
+
+    static Value* GetImage() {
+        return core::Builder.CreateBitCast(Image, core::PtrType);
+    }
+
+    // Changes with the words, their order and the cell format, which cached cells depend on
+    static uint64_t GetVersion() {
+        std::vector<std::string> names(dict::InitialXts.size());
+        for (const auto& entry: dict::Dictionary) { names[dict::XtIndices.at(entry.second.xt)] = entry.first; }
+        names.push_back(std::to_string(dict::MemorySize));
+        names.push_back(dict::Tokens ? "tokens" : "xts");
+        uint64_t hash = 14695981039346656037ULL;
+        for (const auto& name: names) {
+            for (unsigned char c: name + '\0') { hash = (hash ^ c) * 1099511628211ULL; }
+        }
+        return hash;
+    }
+
+    static Constant* GetPointer(Constant* global, Type* type) {
+        return ConstantExpr::getPointerCast(core::CreateConstantGEP(global), type);
+    }
+
+    static void Finalize() {
+        auto null = [](Type* type) { return Constant::getNullValue(type); };
+        auto index_ptr = core::IndexType->getPointerTo();
+        core::CreateGlobalVariable("include_image", ImageType, ConstantStruct::get(ImageType, {
+                GetPointer(dict::Memory, core::StrType),
+                GetPointer(dict::Kinds, core::StrType),
+                dict::HereValue,
+                core::GetInt(dict::MemorySize),
+                core::GetInt(dict::Tokens ? 4 : 8),
+                dict::Tokens ? GetPointer(dict::Pool, core::IntPtrType) : null(core::IntPtrType),
+                dict::Tokens ? GetPointer(dict::PoolKinds, core::StrType) : null(core::StrType),
+                dict::Tokens ? dict::PoolCount : null(index_ptr),
+                core::GetInt(dict::Tokens ? dict::PoolSize : 0),
+                core::CreateConstantGEP(dict::Xts),
+                core::CreateConstantGEP(dict::Headers),
+                dict::WordCount,
+                dict::LastXt,
+                core::GetInt(dict::MaxWords),
+                core::CreateConstantGEP(util::FindCache),
+                core::GetInt(util::FindCacheSize),
+                GetPointer(dict::Strings, core::StrType),
+                dict::StringsHere,
+                core::GetInt(dict::StringsSize),
+                Docol,
+                core::GetInt(GetVersion()),
+                dict::Fence,
+        }));
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        Image = core::CreateGlobalVariable("include_image", ImageType);
+        engine::Finalizers.push_back(Finalize);
+    }
+}
+
+#endif //LLFORTH_CACHE_H
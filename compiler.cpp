@@ -7,6 +7,13 @@
 #include "words.h"
 #include "stack.h"
 #include "util.h"
+#include "trace.h"
+#include "stats.h"
+#include "profile.h"
+#include "cache.h"
+#include "budget.h"
+#include "perf.h"
+#include "embed.h"
 #include "lib.h"
 
 extern "C" {
@@ -25,20 +32,11 @@ Reader::~Reader() {
 
 std::optional<std::string> Reader::read() {
     char buf[1024];
-    char* ptr = buf;
-    int num = read_word_from_reader(raw, ptr, 1024);
-    if (num == 0) {
-        switch(buf[0]) {
-            case 0:
-            case 10:
-                return read();
-            default:
-                return std::nullopt;
-        }
+    while (true) {
+        int num = read_word_from_reader(raw, buf, 1024);
+        if (num > 0) { return std::string(buf, (size_t)num); }
+        if (buf[0] != 0 && buf[0] != 10) { return std::nullopt; }
     }
-    std::string s(buf);
-    assert(s.size() == num);
-    return s;
 }
 
 struct Token {
@@ -51,9 +49,12 @@ struct Token {
         Semicolon,
         BrLabel,
         Immediate,
+        Inline,
         Lit,
         DoubleQuote,
         QuoteString,
+        SQuote,
+        SQuoteString,
     } type;
     std::string value;
 
@@ -61,18 +62,23 @@ struct Token {
         return Token{.value=str, .type=type};
     }
 
+    static bool is_label(const std::string& str) {
+        return str.size() > 2 && str.front() == '.' && str.back() == ':';
+    }
+
     static Token get(const std::string& str) {
-        std::smatch label_match;
         Type type;
-        if (std::regex_match(str, label_match, std::regex("(\\..+):"))) {
-            return get(label_match[1], Label);
+        if (is_label(str)) {
+            return get(str.substr(0, str.size() - 1), Label);
         } else {
             if (str == ":") { type = Colon; }
             else if (str == ";") { type = Semicolon; }
             else if (str == "branch" || str == "0branch") { type = Br; }
             else if (str == "immediate") { type = Immediate; }
+            else if (str == "inline") { type = Inline; }
             else if (str == "'") { type = Lit; }
             else if (str == ".\"") { type = DoubleQuote; }
+            else if (str == "s\"") { type = SQuote; }
             else { type = String; }
             return get(str, type);
         }
@@ -98,6 +104,7 @@ struct Tokenizer {
                 case Token::Br: add_next(Token::BrLabel); break;
                 case Token::Lit: add_next(Token::String); break;
                 case Token::DoubleQuote: add_next(Token::QuoteString); break;
+                case Token::SQuote: add_next(Token::SQuoteString); break;
                 default: break;
             }
         }
@@ -113,15 +120,21 @@ struct Tokenizer {
     }
 };
 
+// Colon bodies of at most this many cells are inlined into the words compiled after them
+static size_t InlineThreshold = 3;
+// Words whose behaviour depends on the return stack frame docol pushes for their caller
+const static std::set<std::string> FrameWords = {"exit", ">r", "r>", "r@", "2>r", "2r>", "i", "j"};
+
 struct WordDefinition {
     struct Code {
-        enum Type {Word, Int, BrLabel, String} type;
+        enum Type {Word, Int, Float, BrLabel, String} type;
         std::string value;
         Constant* xt;
     };
 
     std::string name;
     bool is_immediate = false;
+    bool is_inline = false;
     std::map<std::string, int> labels = {};
     std::vector<Code> codes = {};
 
@@ -137,20 +150,47 @@ struct WordDefinition {
             case Token::String:
                 add_string(token.value); break;
             case Token::DoubleQuote:
+            case Token::SQuote:
             case Token::Lit:
                 add_string("lit"); break;
             case Token::QuoteString:
-                codes.push_back(Code{.type=Code::String, .value=token.value});
-                add_string("prints");
+                add_quote(token.value);
+                add_string("type");
                 break;
+            case Token::SQuoteString:
+                add_quote(token.value); break;
             default:
                 assert(false); break;
         }
     }
 
+    void add_quote(const std::string& value) {
+        codes.push_back(Code{.type=Code::String, .value=value});
+        add_string("lit");
+        codes.push_back(Code{.type=Code::Int, .value=std::to_string(value.size())});
+    }
+
+    static bool is_float(const std::string& value) {
+        if (value.find_first_of(".eE") == std::string::npos) { return false; }
+        // Decimal only, like string_to_float at runtime; stod alone also takes hex, inf and nan
+        if (value.find_first_not_of("0123456789+-.eE") != std::string::npos) { return false; }
+        auto last = value.back();
+        auto literal = (last == 'e' || last == 'E') ? value + "0" : value;
+        try {
+            size_t pos;
+            std::stod(literal, &pos);
+            return pos == literal.size();
+        } catch(...) {
+            return false;
+        }
+    }
+
     void add_string(const std::string& value) {
         auto found = dict::Dictionary.find(value);
-        if (found == dict::Dictionary.end()) {
+        if (found == dict::Dictionary.end() && is_float(value)) {
+            codes.push_back(Code{.type=Code::Word, .xt=words::Flit.xt, .value="flit"});
+            codes.push_back(Code{.type=Code::Float, .value=value});
+        } else if (found == dict::Dictionary.end()) {
             codes.push_back(Code{.type=Code::Word, .xt=words::Lit.xt, .value="lit"});
             codes.push_back(Code{.type=Code::Int, .value=value});
         } else {
@@ -158,10 +198,63 @@ struct WordDefinition {
         }
     }
 
+    // Straight code or local branches, which behave the same spliced into a caller as behind docol and exit
+    bool can_inline() const {
+        if (is_immediate) { return false; }
+        for (const auto& code: codes) {
+            if (code.type == Code::Word && FrameWords.count(code.value)) { return false; }
+        }
+        return is_inline || codes.size() <= InlineThreshold;
+    }
+
+    // compile, copies bodies verbatim at runtime, which only keeps them valid without branches
+    size_t get_inline_cells() const {
+        if (!can_inline()) { return 0; }
+        for (const auto& code: codes) {
+            if (code.type == Code::BrLabel) { return 0; }
+        }
+        return codes.size();
+    }
+
+    // Replaces calls of the words in inlinable by their bodies. Their labels are prefixed with
+    // the callee and its position, and the labels of this word move past the inlined code.
+    void inline_calls(const std::map<std::string, WordDefinition>& inlinable) {
+        std::vector<Code> inlined = {};
+        std::vector<int> positions = {};
+        std::map<std::string, int> inlined_labels = {};
+        bool is_operand = false;
+        for (const auto& code: codes) {
+            positions.push_back((int)inlined.size());
+            auto found = inlinable.end();
+            if (code.type == Code::Word && !is_operand) { found = inlinable.find(code.value); }
+            is_operand = code.type == Code::Word && dict::Operands.count(code.xt);
+            if (found == inlinable.end()) {
+                inlined.push_back(code);
+                continue;
+            }
+            const auto& callee = found->second;
+            auto prefix = callee.name + "@" + std::to_string(inlined.size());
+            for (const auto& label: callee.labels) {
+                inlined_labels[prefix + label.first] = (int)inlined.size() + label.second;
+            }
+            for (auto callee_code: callee.codes) {
+                if (callee_code.type == Code::BrLabel) { callee_code.value = prefix + callee_code.value; }
+                inlined.push_back(callee_code);
+            }
+        }
+        positions.push_back((int)inlined.size());
+        for (const auto& label: labels) {
+            inlined_labels[label.first] = positions[label.second];
+        }
+        labels = inlined_labels;
+        codes = inlined;
+    }
+
     void compile() {
+        auto inline_cells = get_inline_cells();
         add_string("exit");
         auto compiled = std::vector<std::variant<Constant*,int>>();
-        for (auto code: codes) {
+        for (const auto& code: codes) {
             switch (code.type) {
                 case Code::BrLabel: {
                     auto found = labels.find(code.value);
@@ -186,6 +279,12 @@ struct WordDefinition {
                     }
                     break;
                 }
+                case Code::Float: {
+                    auto last = code.value.back();
+                    auto literal = (last == 'e' || last == 'E') ? code.value + "0" : code.value;
+                    compiled.push_back(words::GetConstantFloatToXtPtr(std::stod(literal)));
+                    break;
+                }
                 case Code::String: {
                     auto xt = words::GetConstantStrToXtPtr(code.value);
                     compiled.push_back(xt);
@@ -195,7 +294,7 @@ struct WordDefinition {
                     assert(false);
             }
         }
-        dict::AddColonWord(name, words::Docol.addr, compiled, is_immediate);
+        dict::AddColonWord(name, words::Docol.addr, compiled, is_immediate, inline_cells);
     }
 };
 
@@ -211,13 +310,13 @@ std::ostream& operator<<(std::ostream& os, const WordDefinition& word) {
     return os;
 }
 
-static std::vector<WordDefinition> Parse(const std::vector<Token>& tokens) {
-    std::vector<WordDefinition> words = {};
+// Calls define for each definition at its ;, so the words it compiles can be used by the next ones
+static void Parse(const std::vector<Token>& tokens, const std::function<void(WordDefinition&)>& define) {
     WordDefinition def;
     bool is_def = false;
     auto it = tokens.begin();
     while (it != tokens.end()) {
-        auto token = *it++;
+        const auto& token = *it++;
         switch (token.type) {
             case Token::Colon: {
                 assert(!is_def);
@@ -228,13 +327,11 @@ static std::vector<WordDefinition> Parse(const std::vector<Token>& tokens) {
             case Token::Semicolon: {
                 assert(is_def);
                 is_def = false;
-                auto next = *it++;
-                if (next.type == Token::Immediate) {
-                    def.is_immediate = true;
-                } else {
-                    it--;
+                for (; it != tokens.end() && (it->type == Token::Immediate || it->type == Token::Inline); it++) {
+                    if (it->type == Token::Immediate) { def.is_immediate = true; }
+                    else { def.is_inline = true; }
                 }
-                words.push_back(def);
+                define(def);
                 break;
             }
             default: {
@@ -244,34 +341,74 @@ static std::vector<WordDefinition> Parse(const std::vector<Token>& tokens) {
             }
         }
     }
-    return words;
 }
 
-static void MainLoop(int argc, char** argv) {
-    Reader reader(argc, argv);
+// Options of llforthc itself, removed from argv before the reader parses the rest
+struct Options {
+    bool verbose = false;
+    std::vector<char*> args = {};
+};
+
+static Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace") { trace::Enabled = true; }
+        else if (arg == "--stats") { stats::Enabled = true; }
+        else if (arg == "--perf-symbols") { perf::Enabled = true; }
+        else if (arg == "--replicate-next") { engine::ReplicateNext = true; }
+        else if (arg == "--tokens") { dict::Tokens = true; }
+        else if (arg == "--embed") { engine::Embed = true; }
+        else if (arg == "--shake") { dict::Shake = true; }
+        else if (arg == "--profile-generate") { profile::Generate = true; }
+        else if (arg == "--profile-use" && i + 1 < argc) { profile::UsePath = argv[++i]; }
+        else if (arg == "--budget") { budget::Enabled = true; }
+        else if (arg == "--inline-threshold" && i + 1 < argc) { InlineThreshold = std::stoul(argv[++i]); }
+        else if (arg == "--verbose") { options.verbose = true; }
+        else { options.args.push_back(argv[i]); }
+    }
+    return options;
+}
+
+static void MainLoop(const Options& options) {
+    Reader reader((int)options.args.size(), const_cast<char**>(options.args.data()));
     Tokenizer tokenizer(&reader);
     tokenizer.run();
-    auto words = Parse(tokenizer.tokens);
-    for (auto w: words) {
+    std::map<std::string, WordDefinition> inlinable = {};
+    Parse(tokenizer.tokens, [&](WordDefinition& w) {
+        w.inline_calls(inlinable);
+        // Before compile appends exit
+        if (w.can_inline()) { inlinable[w.name] = w; } else { inlinable.erase(w.name); }
         w.compile();
-        std::cerr << w << std::endl;
-    }
+        if (options.verbose) { std::cerr << w << std::endl; }
+    });
 }
 
 int main(int argc, char** argv) {
+    auto options = ParseOptions(argc, argv);
     core::CreateModule("main");
     engine::Initializers = {
             dict::Initialize,
             stack::Initialize,
+            trace::Initialize,
+            stats::Initialize,
+            profile::Initialize,
+            task::Initialize,
+            cache::Initialize,
+            budget::Initialize,
             words::Initialize,
+            perf::Initialize,
+            embed::Initialize,
     };
     engine::Finalizers = {
+            profile::Layout,
             dict::Finalize,
     };
     engine::Initialize();
 
-    MainLoop(argc, argv);
+    MainLoop(options);
 
     engine::Finalize();
+    if (dict::Shake) { dict::RemoveDeadBlocks(); }
     core::DumpModule();
 }
\ No newline at end of file
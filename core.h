@@ -9,7 +9,6 @@
 #include <fstream>
 #include <sstream>
 #include <string>
-#include <regex>
 #include <functional>
 #include <variant>
 #include <tuple>
@@ -18,6 +17,8 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/raw_ostream.h>
@@ -39,6 +40,8 @@ namespace core {
     const static auto BoolType = Builder.getInt1Ty();
     const static auto IndexType = Builder.getInt32Ty();
     const static auto PtrType = Builder.getInt8PtrTy();
+    const static auto FloatType = Builder.getDoubleTy();
+    const static auto FloatPtrType = FloatType->getPointerTo();
 
     struct Func {
         std::string name;
@@ -61,6 +64,10 @@ namespace core {
         return ConstantInt::get(BoolType, value);
     }
 
+    static Constant* GetFloat(double value) {
+        return ConstantFP::get(FloatType, value);
+    }
+
     static void CreateModule(const std::string& name) {
         TheModule = llvm::make_unique<Module>(name, TheContext);
     }
@@ -125,6 +132,11 @@ namespace core {
         return Builder.CreateCall(callee, args);
     }
 
+    static CallInst* CallIntrinsic(Intrinsic::ID id, ArrayRef<Type*> types, ArrayRef<Value*> args) {
+        auto callee = Intrinsic::getDeclaration(TheModule.get(), id, types);
+        return Builder.CreateCall(callee, args);
+    }
+
 }
 
 #endif //LLVM_FORTH_CORE_H
@@ -5,20 +5,21 @@
 #ifndef LLVM_FORTH_DICT_H
 #define LLVM_FORTH_DICT_H
 
+#include <set>
+#include <llvm/IR/CFG.h>
 #include "core.h"
 #include "engine.h"
 
 namespace dict {
     const static auto AddressType = core::Builder.getInt8PtrTy();
+    const static uint64_t MaxWords = 1024;
+
+    // Only the fields read on every dispatch live in the xt, so the xts table packs them densely.
     static StructType* CreateXtType() {
         auto xt_type = StructType::create(core::TheContext, "xt");
-        auto xt_ptr_type = xt_type->getPointerTo();
         xt_type->setBody({
-            xt_ptr_type,     // Previous word
-            core::StrType,   // Word of node
             AddressType,     // Implementation address
             core::IndexType, // Starting index on main memory array for colon word
-            core::BoolType,  // Immediate flag
         });
         return xt_type;
     };
@@ -26,15 +27,100 @@ namespace dict {
     const static auto XtPtrType = XtType->getPointerTo();
     const static auto XtPtrPtrType = XtPtrType->getPointerTo();
     const static auto XtPtrNull = ConstantPointerNull::get(XtPtrType);
+
+    // The rest of a word lives in the headers table at the same index, used by find and tooling.
+    static StructType* CreateHeaderType() {
+        auto header_type = StructType::create(core::TheContext, "header");
+        header_type->setBody({
+            XtPtrType,       // Previous word
+            core::StrType,   // Word of node
+            core::IntType,   // Length of word
+            core::BoolType,  // Immediate flag
+            core::IndexType, // Cells of the colon body compile, copies instead of compiling a call, 0 for a call
+        });
+        return header_type;
+    };
+    const static auto HeaderType = CreateHeaderType();
+    const static auto HeaderPtrType = HeaderType->getPointerTo();
+
     static Constant* _LastXt = XtPtrNull;
     static Constant* LastXt;
     enum XtMember {
-        XtPrevious, XtWord, XtImplAddress, XtColon, XtImmediate,
+        XtImplAddress, XtColon,
+    };
+    enum HeaderMember {
+        XtPrevious, XtWord, XtWordLength, XtImmediate, XtInline,
+    };
+
+    static std::vector<Constant*> InitialXts = {};
+    static std::vector<Constant*> InitialHeaders = {};
+    static Constant* Xts;
+    static Constant* Headers;
+    static Constant* WordCount;
+    // Words below the fence were compiled by llforthc and cannot be forgotten
+    static Constant* Fence;
+    // Throws -8 when a table of the dictionary is full; words fills it in once throw exists
+    static BasicBlock* OverflowBlock;
+
+    // llforthc --tokens: a code cell is a 32-bit index into xts instead of an xt pointer. Literals
+    // which fit 32 bits and branch offsets relative to their own cell are inline, anything wider
+    // is an index into the literal pool. A data cell written by , spans two code cells, so data
+    // cells are only aligned to DataAlign bytes and every access to them says so.
+    static bool Tokens = false;
+    static Type* CellType = XtPtrType;
+    static Type* CodePtrType = XtPtrPtrType;
+    static uint64_t MemorySize = 1024;
+    static uint64_t DataCells = 1;
+    static unsigned DataAlign = 8;
+    const static uint64_t PoolSize = 1024;
+
+    // What the cell after a word holds, so colon bodies can be encoded as tokens
+    enum Operand {
+        NoOperand, LiteralOperand, FloatOperand,
+    };
+    static std::map<Constant*, Operand> Operands = {};
+    static std::map<Constant*, uint64_t> XtIndices = {};
+    static Constant* WideLitXt;
+
+    // llforthc --shake: only words reachable from main keep their xt, header and indirectbr
+    // destination. Colon bodies reference the xts they compile, native words the xts they pass
+    // to GetXtCell. find and interpret reach any word by name, so programs using them keep all.
+    static bool Shake = false;
+    static std::map<Constant*, std::vector<Constant*>> References = {};
+    static std::vector<Constant*> NativeReferences = {};
+    const static std::vector<std::string> NamedLookups = {"find", "interpret"};
+
+    // What each cell of dict_memory holds, so that the include cache can save compiled code and
+    // load it at another address. A pool cell indexes a literal pool entry of the kind in pool_kinds.
+    enum CellKind {
+        RawCell, XtCell, TargetCell, StringCell, PoolCell,
     };
 
     static std::vector<Constant*> InitialMemory = {};
+    static std::vector<Constant*> InitialKinds = {};
+    // Every colon body on InitialMemory, and the cells holding an absolute branch target, so that
+    // MoveBodies can rearrange them before Finalize. Token branch offsets are relative and move as is.
+    struct Body {
+        Constant* xt;
+        uint64_t start;
+        uint64_t end;
+    };
+    static std::vector<Body> Bodies = {};
+    static std::set<uint64_t> TargetCells = {};
+    static std::map<uint64_t, uint64_t> Moved = {};
     static Constant* Memory;
     static Constant* HereValue;
+    static std::vector<Constant*> InitialPool = {};
+    static Constant* Pool;
+    static Constant* PoolCount;
+    static std::vector<Constant*> InitialPoolKinds = {};
+    static Constant* Kinds;
+    static Constant* PoolKinds;
+
+    // Names and string literals created at runtime, instead of allocas in main's frame
+    const static uint64_t StringsSize = 64 * 1024;
+    static Constant* Strings;
+    static Constant* StringsHere;
 
     struct Word {
         Constant* xt;
@@ -42,6 +128,8 @@ namespace dict {
         BasicBlock* block;
     };
     static std::vector<BasicBlock*> NativeBlocks = {};
+    // Destinations are added at Finalize, once every native word exists
+    static std::vector<IndirectBrInst*> IndirectBrs = {};
     static std::map<std::string, Word> Dictionary = {};
     static Word Main;
 
@@ -50,15 +138,86 @@ namespace dict {
     }
 
     static Constant* AddXt(const std::string& word, Constant* lastXt, Constant* str,
-                           BlockAddress* addr, Constant* colon, Constant* flag) {
+                           BlockAddress* addr, Constant* colon, Constant* flag, uint64_t inline_cells=0) {
         if (!lastXt)   { lastXt   = ConstantPointerNull::get(XtPtrType); }
         if (!str)      { str      = ConstantPointerNull::get(core::StrType); }
         if (!colon)    { colon    = core::GetIndex(-1); }
         if (!flag)     { flag     = core::GetBool(false); }
-        auto value = ConstantStruct::get(XtType, lastXt, str, addr, colon, flag);
-        return core::CreateGlobalVariable("xt_" + word, XtType, value);
+        auto length = core::GetInt(word.size());
+        auto index = InitialXts.size();
+        InitialXts.push_back(ConstantStruct::get(XtType, addr, colon));
+        InitialHeaders.push_back(ConstantStruct::get(HeaderType, lastXt, str, length, flag, core::GetIndex(inline_cells)));
+        Constant* idx[] = {core::GetIndex(0), core::GetIndex(index)};
+        auto xt = ConstantExpr::getInBoundsGetElementPtr(ArrayType::get(XtType, MaxWords), Xts, idx);
+        XtIndices[xt] = index;
+        return xt;
     };
 
+    static Type* GetMemoryType() {
+        return ArrayType::get(CellType, MemorySize);
+    }
+
+    // The integer a literal cell holds, or nullptr for an address only known at link time
+    static ConstantInt* GetLiteralInt(Constant* value) {
+        if (value->isNullValue()) { return ConstantInt::get(core::IntType, 0); }
+        auto expr = dyn_cast<ConstantExpr>(value);
+        if (expr && expr->getOpcode() == Instruction::IntToPtr) { return dyn_cast<ConstantInt>(expr->getOperand(0)); }
+        return nullptr;
+    }
+
+    static Constant* GetToken(Constant* xt) {
+        return core::GetIndex(XtIndices.at(xt));
+    }
+
+    static Constant* GetKind(CellKind kind) {
+        return ConstantInt::get(core::CharType, kind);
+    }
+
+    static Constant* AddPoolValue(Constant* value) {
+        Constant* bits = GetLiteralInt(value);
+        InitialPool.push_back(bits ? bits : ConstantExpr::getPtrToInt(value, core::IntType));
+        InitialPoolKinds.push_back(GetKind(XtIndices.count(value) ? XtCell : RawCell));
+        return core::GetIndex(InitialPool.size() - 1);
+    }
+
+    // Same cell count as the xt encoding, so branch targets keep their positions. Adds the words
+    // the cells call besides those in words, i.e. wlit, to references.
+    static std::vector<Constant*> CompileTokens(const std::vector<std::variant<Constant*,int>>& words,
+                                                std::vector<Constant*>& kinds, std::vector<Constant*>& references) {
+        std::vector<Constant*> cells = {};
+        auto operand = NoOperand;
+        for (size_t i = 0; i < words.size(); i++) {
+            if (auto target = std::get_if<int>(&words[i])) {
+                cells.push_back(ConstantInt::get(core::IndexType, *target - (int)i, true));
+                kinds.push_back(GetKind(TargetCell));
+                operand = NoOperand;
+                continue;
+            }
+            auto value = std::get<Constant*>(words[i]);
+            if (operand == NoOperand) {
+                cells.push_back(GetToken(value));
+                kinds.push_back(GetKind(XtCell));
+                auto found = Operands.find(value);
+                operand = found == Operands.end() ? NoOperand : found->second;
+                continue;
+            }
+            auto literal = GetLiteralInt(value);
+            if (operand == LiteralOperand && literal && isInt<32>(literal->getSExtValue())) {
+                cells.push_back(ConstantInt::get(core::IndexType, literal->getSExtValue(), true));
+                kinds.push_back(GetKind(RawCell));
+            } else {
+                if (operand == LiteralOperand) {
+                    cells.back() = GetToken(WideLitXt);
+                    references.push_back(WideLitXt);
+                }
+                cells.push_back(AddPoolValue(value));
+                kinds.push_back(GetKind(PoolCell));
+            }
+            operand = NoOperand;
+        }
+        return cells;
+    }
+
     static Word AddWord(const std::string& name, Constant* xt, BlockAddress* addr, BasicBlock* block=nullptr) {
         Word w{xt, addr, block};
         Dictionary[name] = w;
@@ -68,32 +227,49 @@ namespace dict {
     static Word AddNativeWord(const std::string& name, const std::function<void()>& impl) {
         auto block = core::CreateBasicBlock("i_" + name, engine::MainFunction);
         core::Builder.SetInsertPoint(block);
+        NativeReferences.clear();
         impl();
         NativeBlocks.push_back(block);
         auto addr = BlockAddress::get(block);
         auto str = core::Builder.CreateGlobalStringPtr(name);
         auto xt = AddXt(name, _LastXt, str, addr, nullptr, nullptr);
+        References[xt] = NativeReferences;
         _LastXt = xt;
         return AddWord(name, xt, addr, block);
     };
 
-    static Word AddColonWord(const std::string& name, BlockAddress* addr, std::vector<std::variant<Constant*,int>> words, bool flag=false) {
+    static Word AddColonWord(const std::string& name, BlockAddress* addr, std::vector<std::variant<Constant*,int>> words,
+                             bool flag=false, uint64_t inline_cells=0) {
         auto str = core::Builder.CreateGlobalStringPtr(name);
         auto start = InitialMemory.size();
         auto here = core::GetIndex(start);
         std::vector<Constant*> compiled_words = {};
-        for (auto w: words) {
+        std::vector<Constant*> kinds = {};
+        std::vector<Constant*> references = {};
+        if (Tokens) { compiled_words = CompileTokens(words, kinds, references); }
+        else for (auto w: words) {
             try {
                 auto i = std::get<int>(w);
+                TargetCells.insert(start + compiled_words.size());
                 compiled_words.push_back(GetConstantIntToXtPtr(start + i));
+                kinds.push_back(GetKind(TargetCell));
             }
             catch (const std::bad_variant_access&) {
-                compiled_words.push_back(std::get<Constant*>(w));
+                auto value = std::get<Constant*>(w);
+                compiled_words.push_back(value);
+                kinds.push_back(GetKind(XtIndices.count(value) ? XtCell : RawCell));
             }
         }
         InitialMemory.insert(InitialMemory.end(), compiled_words.begin(), compiled_words.end());
-        auto xt = AddXt(name, _LastXt, str, addr, here, core::GetBool(flag));
+        InitialKinds.insert(InitialKinds.end(), kinds.begin(), kinds.end());
+        auto xt = AddXt(name, _LastXt, str, addr, here, core::GetBool(flag), inline_cells);
         _LastXt = xt;
+        Bodies.push_back(Body{xt, start, InitialMemory.size()});
+        References[xt] = references;
+        for (auto w: words) {
+            auto value = std::get_if<Constant*>(&w);
+            if (value && XtIndices.count(*value)) { References[xt].push_back(*value); }
+        }
         auto word = AddWord(name, xt, addr);
         if (name == "main") { Main = word; }
         return word;
@@ -103,6 +279,14 @@ namespace dict {
         return core::Builder.CreateLoad(engine::W);
     };
 
+    static Value* GetXtIndex(Value* xt) {
+        return core::Builder.CreatePtrDiff(xt, core::CreateConstantGEP(Xts));
+    };
+
+    static Value* GetHeader(Value* xt) {
+        return core::Builder.CreateGEP(Headers, {core::GetInt(0), GetXtIndex(xt)});
+    };
+
     static Value* GetXtMember(Value* xt, XtMember member) {
         auto ptr = core::Builder.CreateGEP(xt, {core::GetIndex(0), core::GetIndex(member)});
         return core::Builder.CreateLoad(ptr);
@@ -110,42 +294,273 @@ namespace dict {
     static Value* GetXtMember(XtMember member) {
         return GetXtMember(GetXt(), member);
     };
-    static Value* GetXtPrevious(Value* xt)    { return GetXtMember(xt, XtPrevious);    };
-    static Value* GetXtWord(Value* xt)        { return GetXtMember(xt, XtWord);        };
-    static Value* GetXtImplAddress(Value* xt) { return GetXtMember(xt, XtImplAddress); };
-    static Value* GetXtColon(Value* xt)       { return GetXtMember(xt, XtColon);       };
-    static Value* GetXtImmediate(Value* xt)   { return GetXtMember(xt, XtImmediate);   };
-    static Value* GetXtPrevious()    { return GetXtMember(XtPrevious);    };
-    static Value* GetXtWord()        { return GetXtMember(XtWord);        };
+    static Value* GetHeaderMember(Value* xt, HeaderMember member) {
+        auto ptr = core::Builder.CreateGEP(GetHeader(xt), {core::GetIndex(0), core::GetIndex(member)});
+        return core::Builder.CreateLoad(ptr);
+    };
+    static Value* GetXtPrevious(Value* xt)    { return GetHeaderMember(xt, XtPrevious);   };
+    static Value* GetXtWord(Value* xt)        { return GetHeaderMember(xt, XtWord);       };
+    static Value* GetXtWordLength(Value* xt)  { return GetHeaderMember(xt, XtWordLength); };
+    static Value* GetXtImmediate(Value* xt)   { return GetHeaderMember(xt, XtImmediate);  };
+    static Value* GetXtInline(Value* xt)      { return GetHeaderMember(xt, XtInline);     };
+    static Value* GetXtImplAddress(Value* xt) { return GetXtMember(xt, XtImplAddress);    };
+    static Value* GetXtColon(Value* xt)       { return GetXtMember(xt, XtColon);          };
     static Value* GetXtImplAddress() { return GetXtMember(XtImplAddress); };
     static Value* GetXtColon()       { return GetXtMember(XtColon);       };
-    static Value* GetXtImmediate()   { return GetXtMember(XtImmediate);   };
 
     static Value* GetLastXt() {
         return core::Builder.CreateLoad(LastXt);
     };
 
+    // The cell which compiles an xt, and back
+    static Constant* GetXtCell(Constant* xt) {
+        NativeReferences.push_back(xt);
+        return Tokens ? GetToken(xt) : xt;
+    }
+    static Value* CreateXtCell(Value* xt) {
+        return Tokens ? core::Builder.CreateTrunc(GetXtIndex(xt), core::IndexType) : xt;
+    }
+    static Value* DecodeXt(Value* cell) {
+        return Tokens ? core::Builder.CreateGEP(Xts, {core::GetIndex(0), cell}) : cell;
+    }
+
+    // Continues in the block name_ok unless is_full, when it throws dictionary overflow
+    static void CreateOverflowCheck(const std::string& name, Value* is_full) {
+        auto ok = core::CreateBasicBlock(name + "_ok", engine::MainFunction);
+        core::Builder.CreateCondBr(is_full, OverflowBlock, ok);
+        core::Builder.SetInsertPoint(ok);
+    }
+
+    // The cell holding a 64-bit literal of kind, which goes to the literal pool with tokens
+    static Value* CreateWideCell(Value* value, CellKind kind=RawCell) {
+        if (!Tokens) { return core::Builder.CreateIntToPtr(value, XtPtrType); }
+        auto index = core::Builder.CreateLoad(PoolCount);
+        CreateOverflowCheck("pool", core::Builder.CreateICmpUGE(index, core::GetIndex(PoolSize)));
+        core::Builder.CreateStore(value, core::Builder.CreateGEP(Pool, {core::GetIndex(0), index}));
+        core::Builder.CreateStore(GetKind(kind), core::Builder.CreateGEP(PoolKinds, {core::GetIndex(0), index}));
+        core::Builder.CreateStore(core::Builder.CreateAdd(index, core::GetIndex(1)), PoolCount);
+        return index;
+    }
+    static Value* GetWideValue(Value* cell) {
+        if (!Tokens) { return core::Builder.CreatePtrToInt(cell, core::IntType); }
+        return core::Builder.CreateLoad(core::Builder.CreateGEP(Pool, {core::GetIndex(0), cell}));
+    }
+
+    // The operand cell at index of a branch to the cell index target, and where a branch whose operand is at pc goes
+    static Value* CreateTargetCell(Value* target, Value* index) {
+        if (!Tokens) { return core::Builder.CreateIntToPtr(target, XtPtrType); }
+        return core::Builder.CreateSub(target, index);
+    }
+    static Value* DecodeTarget(Value* pc) {
+        auto cell = core::Builder.CreateLoad(pc);
+        if (Tokens) { return core::Builder.CreateGEP(pc, cell); }
+        auto offset = core::Builder.CreatePtrToInt(cell, core::IndexType);
+        return core::Builder.CreateGEP(Memory, {core::GetIndex(0), offset});
+    }
+
+    // Stores a cell of kind at here and moves here past the code cells it takes
+    static void Append(Value* value, CellKind kind, uint64_t cells=1) {
+        auto here = core::Builder.CreateLoad(HereValue);
+        auto here_memory = core::Builder.CreateGEP(Memory, {core::GetIndex(0), here});
+        core::Builder.CreateAlignedStore(value, core::Builder.CreateBitCast(here_memory, value->getType()->getPointerTo()), DataAlign);
+        for (uint64_t i = 0; i < cells; i++) {
+            auto index = core::Builder.CreateAdd(here, core::GetIndex(i));
+            core::Builder.CreateStore(GetKind(kind), core::Builder.CreateGEP(Kinds, {core::GetIndex(0), index}));
+        }
+        core::Builder.CreateStore(core::Builder.CreateAdd(here, core::GetIndex(cells)), HereValue);
+    }
+
+    // Appends the word xt, if any, and a 64-bit literal of kind, through the literal pool with
+    // tokens. The pool entry is taken first, so a full pool throws before anything is compiled.
+    static void AppendWide(Value* value, CellKind kind, Constant* xt=nullptr) {
+        auto cell = CreateWideCell(value, kind);
+        if (xt) { Append(GetXtCell(xt), XtCell); }
+        Append(cell, Tokens ? PoolCell : kind);
+    }
+
+    // Where the colon body which started at start on InitialMemory starts now
+    static uint64_t GetMoved(uint64_t start) {
+        auto found = Moved.find(start);
+        return found == Moved.end() ? start : found->second;
+    }
+
+    // Lays out the colon bodies on InitialMemory in the order of their indices into Bodies, and
+    // updates the xts and branch targets pointing into them. Must run before Finalize.
+    static void MoveBodies(const std::vector<size_t>& order) {
+        std::vector<Constant*> memory = {};
+        std::vector<Constant*> kinds = {};
+        std::set<uint64_t> target_cells = {};
+        std::vector<Body> bodies = {};
+        for (auto i: order) {
+            const auto& body = Bodies[i];
+            auto start = memory.size();
+            for (auto cell = body.start; cell < body.end; cell++) {
+                auto value = InitialMemory[cell];
+                if (TargetCells.count(cell)) {
+                    auto target = GetLiteralInt(value)->getZExtValue();
+                    value = GetConstantIntToXtPtr(target - body.start + start);
+                    target_cells.insert(memory.size());
+                }
+                memory.push_back(value);
+                kinds.push_back(InitialKinds[cell]);
+            }
+            auto index = XtIndices.at(body.xt);
+            auto xt = InitialXts[index];
+            InitialXts[index] = ConstantStruct::get(XtType, xt->getAggregateElement(XtImplAddress), core::GetIndex(start));
+            Moved[body.start] = start;
+            bodies.push_back(Body{body.xt, start, memory.size()});
+        }
+        InitialMemory = memory;
+        InitialKinds = kinds;
+        TargetCells = target_cells;
+        Bodies = bodies;
+    }
+
+    static std::set<Constant*> GetReachableXts() {
+        std::set<Constant*> reachable = {};
+        std::vector<Constant*> work = {Main.xt};
+        while (!work.empty()) {
+            auto xt = work.back();
+            work.pop_back();
+            if (!reachable.insert(xt).second) { continue; }
+            const auto& references = References[xt];
+            work.insert(work.end(), references.begin(), references.end());
+        }
+        // The host of an embedded VM may also call any word
+        auto keep_all = engine::Embed;
+        for (const auto& name: NamedLookups) {
+            auto found = Dictionary.find(name);
+            if (found != Dictionary.end() && reachable.count(found->second.xt)) { keep_all = true; }
+        }
+        if (keep_all) {
+            for (const auto& entry: XtIndices) { reachable.insert(entry.first); }
+        }
+        return reachable;
+    }
+
+    // Clears the table entries of unreachable words, so the indices of the others stay valid, relinks
+    // the headers around them and leaves only the implementations of reachable words in NativeBlocks.
+    // Returns the names of the dropped words.
+    static std::vector<Constant*> ShakeTables() {
+        auto reachable = GetReachableXts();
+        std::vector<Constant*> xts(InitialXts.size());
+        for (const auto& entry: XtIndices) { xts[entry.second] = entry.first; }
+        std::vector<Constant*> names = {};
+        std::set<BasicBlock*> blocks = {};
+        Constant* previous = XtPtrNull;
+        for (size_t i = 0; i < xts.size(); i++) {
+            auto header = InitialHeaders[i];
+            if (!reachable.count(xts[i])) {
+                names.push_back(header->getAggregateElement(XtWord));
+                InitialXts[i] = Constant::getNullValue(XtType);
+                InitialHeaders[i] = Constant::getNullValue(HeaderType);
+                continue;
+            }
+            InitialHeaders[i] = ConstantStruct::get(HeaderType, previous, header->getAggregateElement(XtWord),
+                    header->getAggregateElement(XtWordLength), header->getAggregateElement(XtImmediate),
+                    header->getAggregateElement(XtInline));
+            previous = xts[i];
+            blocks.insert(cast<BlockAddress>(InitialXts[i]->getAggregateElement(XtImplAddress))->getBasicBlock());
+        }
+        _LastXt = previous;
+        std::vector<BasicBlock*> native_blocks = {};
+        for (auto block: NativeBlocks) {
+            if (blocks.count(block)) { native_blocks.push_back(block); }
+        }
+        NativeBlocks = native_blocks;
+        return names;
+    }
+
+    // After the tables are shaken, the code of dropped words can only be reached through their
+    // block addresses, which are gone, so it is removed once main is complete
+    static void RemoveDeadBlocks() {
+        auto main = engine::MainFunction;
+        std::set<BasicBlock*> live = {};
+        std::vector<BasicBlock*> work = {&main->getEntryBlock()};
+        while (!work.empty()) {
+            auto block = work.back();
+            work.pop_back();
+            if (!live.insert(block).second) { continue; }
+            for (auto successor: successors(block)) { work.push_back(successor); }
+        }
+        std::vector<BasicBlock*> dead = {};
+        for (auto& block: *main) {
+            if (!live.count(&block)) { dead.push_back(&block); }
+        }
+        for (auto block: dead) {
+            for (auto successor: successors(block)) { successor->removePredecessor(block); }
+            block->dropAllReferences();
+        }
+        for (auto block: dead) { block->eraseFromParent(); }
+    }
+
     static void Initialize(Function* main, BasicBlock* entry) {
-        Memory = core::CreateGlobalVariable("dict_memory", ArrayType::get(XtPtrType, 1024));
+        if (Tokens) {
+            CellType = core::IndexType;
+            CodePtrType = CellType->getPointerTo();
+            MemorySize = 2048;
+            DataCells = 2;
+            DataAlign = 4;
+            Pool = core::CreateGlobalVariable("literal_pool", ArrayType::get(core::IntType, PoolSize));
+            PoolCount = core::CreateGlobalVariable("pool_count", core::IndexType);
+            PoolKinds = core::CreateGlobalVariable("pool_kinds", ArrayType::get(core::CharType, PoolSize));
+        }
+        Memory = core::CreateGlobalVariable("dict_memory", GetMemoryType());
+        Kinds = core::CreateGlobalVariable("dict_kinds", ArrayType::get(core::CharType, MemorySize));
+        Strings = core::CreateGlobalArrayVariable("dict_strings", core::CharType, StringsSize, false);
+        StringsHere = core::CreateGlobalVariable("strings_here", core::IntType, core::GetInt(0), false);
         HereValue = core::CreateGlobalVariable("here", core::IndexType);
-        engine::PC = core::Builder.CreateAlloca(XtPtrPtrType, nullptr, "pc");
+        engine::PC = core::Builder.CreateAlloca(CodePtrType, nullptr, "pc");
         engine::W = core::Builder.CreateAlloca(XtPtrType, nullptr, "w");
         LastXt = core::CreateGlobalVariable("last_xt", XtPtrType);
+        Xts = core::CreateGlobalVariable("xts", ArrayType::get(XtType, MaxWords));
+        Headers = core::CreateGlobalVariable("headers", ArrayType::get(HeaderType, MaxWords));
+        WordCount = core::CreateGlobalVariable("word_count", core::IndexType);
+        Fence = core::CreateGlobalVariable("fence", core::IndexType);
+        OverflowBlock = core::CreateBasicBlock("dict_overflow", main);
         engine::Jump = [](){
-            auto br = core::Builder.CreateIndirectBr(GetXtImplAddress(), (unsigned int)NativeBlocks.size());
-            for (auto block : NativeBlocks) {
-                br->addDestination(block);
-            }
+            IndirectBrs.push_back(core::Builder.CreateIndirectBr(GetXtImplAddress()));
         };
+        engine::Decode = DecodeXt;
     }
 
     static void Finalize() {
+        std::vector<Constant*> dropped_names = {};
+        if (Shake) { dropped_names = ShakeTables(); }
         HereValue = core::CreateGlobalVariable("here", core::IndexType, core::GetIndex(InitialMemory.size()), false);
-        InitialMemory.resize(1024, ConstantPointerNull::get(XtPtrType));
-        Memory = core::CreateGlobalArrayVariable("dict_memory", XtPtrType, InitialMemory, false);
-        auto start = core::Builder.CreateGEP(Memory, {core::GetIndex(0), GetXtColon(Main.xt)});
-        core::Builder.CreateStore(start, engine::PC);
+        InitialMemory.resize(MemorySize, Constant::getNullValue(CellType));
+        Memory = core::CreateGlobalArrayVariable("dict_memory", CellType, InitialMemory, false);
+        InitialKinds.resize(MemorySize, GetKind(RawCell));
+        Kinds = core::CreateGlobalArrayVariable("dict_kinds", core::CharType, InitialKinds, false);
+        if (Tokens) {
+            PoolCount = core::CreateGlobalVariable("pool_count", core::IndexType, core::GetIndex(InitialPool.size()), false);
+            InitialPool.resize(PoolSize, ConstantInt::get(core::IntType, 0));
+            Pool = core::CreateGlobalArrayVariable("literal_pool", core::IntType, InitialPool, false);
+            InitialPoolKinds.resize(PoolSize, GetKind(RawCell));
+            PoolKinds = core::CreateGlobalArrayVariable("pool_kinds", core::CharType, InitialPoolKinds, false);
+        }
+        if (!engine::Embed) {
+            auto start = core::Builder.CreateGEP(Memory, {core::GetIndex(0), GetXtColon(Main.xt)});
+            core::Builder.CreateStore(start, engine::PC);
+        }
         LastXt = core::CreateGlobalVariable("last_xt", XtPtrType, _LastXt, false);
+        WordCount = core::CreateGlobalVariable("word_count", core::IndexType, core::GetIndex(InitialXts.size()), false);
+        Fence = core::CreateGlobalVariable("fence", core::IndexType, core::GetIndex(InitialXts.size()));
+        InitialXts.resize(MaxWords, Constant::getNullValue(XtType));
+        InitialHeaders.resize(MaxWords, Constant::getNullValue(HeaderType));
+        Xts = core::CreateGlobalArrayVariable("xts", XtType, InitialXts, false);
+        Headers = core::CreateGlobalArrayVariable("headers", HeaderType, InitialHeaders, false);
+        for (auto br : IndirectBrs) {
+            for (auto block : NativeBlocks) {
+                br->addDestination(block);
+            }
+        }
+        for (auto name : dropped_names) {
+            auto global = dyn_cast<GlobalVariable>(name->stripPointerCasts());
+            if (!global) { continue; }
+            global->removeDeadConstantUsers();
+            if (global->use_empty()) { global->eraseFromParent(); }
+        }
     }
 }
 
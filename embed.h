@@ -0,0 +1,64 @@
+#ifndef LLFORTH_EMBED_H
+#define LLFORTH_EMBED_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "stack.h"
+#include "words.h"
+#include "budget.h"
+
+// The VM as a library for `llforthc --embed`. Instead of main, the module exports
+// llforth_enter(reader, xt), which runs xt and returns 0 once it returns, or the code
+// of a throw. A null xt resumes the run the budget stopped instead. The stacks live in
+// globals, so they persist between calls; libllforth.cpp wraps this into the C API of llforth.h.
+namespace embed {
+    const static core::Func PushFunc {
+        "llforth_stack_push", FunctionType::get(core::VoidType, {core::IntType}, false)
+    };
+    const static core::Func PopFunc {
+        "llforth_stack_pop", FunctionType::get(core::IntType, {}, false)
+    };
+    const static core::Func DepthFunc {
+        "llforth_stack_depth", FunctionType::get(core::IntType, {}, false)
+    };
+
+    // Colon body whose first cell is overwritten with the xt to run and whose second returns to the host
+    static uint64_t EnterColon;
+
+    static void Finalize() {
+        auto xt = core::Builder.CreateBitCast(engine::MainFunction->arg_begin() + 1, dict::XtPtrType);
+        auto is_resume = core::Builder.CreateIsNull(xt);
+        auto code = core::Builder.CreateGEP(dict::Memory, {core::GetIndex(0), core::GetIndex(dict::GetMoved(EnterColon))});
+        auto cell = core::Builder.CreateSelect(is_resume, core::Builder.CreateLoad(code), dict::CreateXtCell(xt));
+        core::Builder.CreateStore(cell, code);
+        auto resume_pc = core::Builder.CreateLoad(budget::ResumePC);
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_resume, resume_pc, code), engine::PC);
+        // A throw leaves the return stack as it was, so every call but a resume starts from an empty one
+        auto rsp = core::Builder.CreateLoad(stack::RSP);
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_resume, rsp, stack::GetBase()), stack::RSP);
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        if (!engine::Embed) { return; }
+        core::CreateFunction(PushFunc, [](Function* f, BasicBlock* entry){
+            stack::Push(f->arg_begin());
+            core::Builder.CreateRetVoid();
+        });
+        core::CreateFunction(PopFunc, [](Function* f, BasicBlock* entry){
+            core::Builder.CreateRet(stack::Pop());
+        });
+        core::CreateFunction(DepthFunc, [](Function* f, BasicBlock* entry){
+            auto depth = core::Builder.CreateSub(core::Builder.CreateLoad(stack::SP), stack::GetBase());
+            core::Builder.CreateRet(core::Builder.CreateIntCast(depth, core::IntType, true));
+        });
+        auto host = dict::AddNativeWord("(host)", [](){
+            core::Builder.CreateRet(core::GetInt(0));
+        });
+        EnterColon = dict::InitialMemory.size();
+        dict::AddColonWord("(enter)", words::Docol.addr, {host.xt, host.xt});
+        engine::Finalizers.push_back(Finalize);
+    }
+}
+
+#endif //LLFORTH_EMBED_H
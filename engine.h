@@ -17,9 +17,19 @@ namespace engine {
     static std::vector<std::function<void(Function*, BasicBlock*)>> Initializers = {};
     static std::vector<std::function<void()>> Finalizers = {};
     static std::function<void()> Jump;
+    // Turns the code cell fetched from pc into W
+    static std::function<Value*(Value*)> Decode;
+    static bool ReplicateNext = false;
+    // llforthc --embed: the module is a library whose entry is llforth_enter instead of main, see embed.h
+    static bool Embed = false;
+    // Emitted in the next block between fetching W and the jump; empty unless a tool needs it
+    static std::vector<std::function<void()>> NextHooks = {};
 
     static void Initialize() {
         core::Func main = {"main", FunctionType::get(core::IntType, {core::IntType, core::StrPtrType}, false)};
+        if (Embed) {
+            main = {"llforth_enter", FunctionType::get(core::IntType, {core::PtrType, core::PtrType}, false)};
+        }
         MainFunction = core::CreateFunction(main);
         Entry = core::CreateBasicBlock("entry", MainFunction);
         Next = core::CreateBasicBlock("next", MainFunction);
@@ -30,19 +40,37 @@ namespace engine {
         }
     };
 
+    // Fetches the next xt and jumps to its implementation
+    static void Dispatch() {
+        auto pc = core::Builder.CreateLoad(PC);
+        core::Builder.CreateStore(Decode(core::Builder.CreateLoad(pc)), W);
+        auto new_pc = core::Builder.CreateGEP(pc, core::GetIndex(1));
+        core::Builder.CreateStore(new_pc, PC);
+        for (const auto hook: NextHooks) {
+            hook();
+        }
+        Jump();
+    }
+
+    // With ReplicateNext every native word dispatches by itself, so each indirectbr
+    // has its own branch history instead of all words sharing the one in next.
+    static void CreateBrNext() {
+        if (ReplicateNext) {
+            Dispatch();
+        } else {
+            core::Builder.CreateBr(Next);
+        }
+    }
+
     static void Finalize() {
+        core::Builder.SetInsertPoint(Next);
+        Dispatch();
+
         for (const auto finalizer: Finalizers) {
             core::Builder.SetInsertPoint(Entry);
             finalizer();
         }
         core::Builder.CreateBr(Next);
-
-        core::Builder.SetInsertPoint(Next);
-        auto pc = core::Builder.CreateLoad(PC);
-        core::Builder.CreateStore(core::Builder.CreateLoad(pc), W);
-        auto new_pc = core::Builder.CreateGEP(pc, core::GetIndex(1));
-        core::Builder.CreateStore(new_pc, PC);
-        Jump();
     };
 }
 
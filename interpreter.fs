@@ -1,9 +1,9 @@
-: if ' 0branch , here@ 0 , ; immediate
-: else ' branch , here@ 0 , swap here swap ! ; immediate
-: then here swap ! ; immediate
+: if ' 0branch compile, here@ 0 branch, ; immediate
+: else ' branch compile, here@ 0 branch, swap here swap branch! ; immediate
+: then here swap branch! ; immediate
 
 : begin here ; immediate
-: until ' 0branch , , ; immediate
+: until ' 0branch compile, branch, ; immediate
 
 : 0> 0 > ;
 : 0< 0 < ;
@@ -13,65 +13,91 @@
 : 2dup over over ;
 : 2drop drop drop ;
 
-: while ' 0branch , here@ 0 , ; immediate
-: repeat ' branch , here 1+ swap ! , ; immediate
-: leave ' branch , here@ swap 0 , ; immediate
+: while ' 0branch compile, here@ 0 branch, ; immediate
+: repeat ' branch compile, here 1+ swap branch! branch, ; immediate
+: leave ' branch compile, here@ swap 0 branch, ; immediate
 
-: do here ' >r , ' >r , ; immediate
-: loop ' r> , ' r> , ' 1+ , ' 2dup , ' = , ' 0branch , , ' 2drop , ; immediate
-: +loop ' r> , ' r> , ' rot , ' + , ' 2dup , ' = , ' 0branch , , ' 2drop , ; immediate
+: do here ' >r compile, ' >r compile, ; immediate
+: loop ' r> compile, ' r> compile, ' 1+ compile, ' 2dup compile, ' = compile, ' 0branch compile, branch, ' 2drop compile, ; immediate
+: +loop ' r> compile, ' r> compile, ' rot compile, ' + compile, ' 2dup compile, ' = compile, ' 0branch compile, branch, ' 2drop compile, ; immediate
 
 : ."
     state @
     0branch .interpreting
 
     inbuf word
-    inbuf strcpy
-    ' lit , ,
-    ' prints ,
+    inbuf swap sliteral
+    ' type compile,
     exit
 
 .interpreting:
     inbuf word
-    drop
-    inbuf prints
+    inbuf swap type
 
 ; immediate
 
-: main
-
-.start:
-    inbuf word
-    0branch .empty
-    inbuf find
-    dup
-    0branch .number
-
+: s"
     state @
     0branch .interpreting
 
-    flag@
-    0branch .compiling
+    inbuf word
+    inbuf swap sliteral
+    exit
 
 .interpreting:
-    execute
-    branch .start
+    inbuf word
+    dup inbuf strcpy
+    swap
+
+; immediate
+
+: marker
+    (marker)
+    inbuf word inbuf create
+    literal literal literal literal
+    ' (forget) compile,
+    ' exit compile,
+;
 
-.compiling:
-    ,
+: forget
+    inbuf word inbuf swap find
+    (forget-state)
+    (forget)
+;
+
+: evaluate
+    (evaluate)
+
+.start:
+    interpret
+    inbuf@ -1 <>
+    0branch .end
     branch .start
 
-.number:
-    drop
-    inbuf number
+.end:
+;
 
-    state @
-    0branch .start
+: include
+    inbuf word
+    inbuf swap (include)
+    0branch .cached
 
-    lit lit , ,
+.start:
+    interpret
+    inbuf@ -1 <>
+    0branch .end
     branch .start
 
-.empty:
+.end:
+    (include-end)
+
+.cached:
+;
+
+: main
+
+.start:
+    interpret
     inbuf@ 10 <>
     0branch .enter
     inbuf@ -1 <>
@@ -85,4 +111,4 @@
 .end:
     bye
 
-;
\ No newline at end of file
+;
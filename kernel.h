@@ -0,0 +1,194 @@
+#ifndef LLFORTH_KERNEL_H
+#define LLFORTH_KERNEL_H
+
+#include "core.h"
+
+// Array kernels over cells. The main loop works on VectorWidth cells at a time with
+// explicit vector IR, so it is vectorized even though llc runs no loop vectorizer,
+// and a scalar loop handles the remaining tail.
+namespace kernel {
+    const static unsigned VectorWidth = 4;
+    const static auto CellVectorType = VectorType::get(core::IntType, VectorWidth);
+    // Of the cells the kernels are given, which need not be 8 bytes with --tokens
+    static unsigned CellAlign = 8;
+
+    const static core::Func SumFunc {
+        "vector_sum", FunctionType::get(core::IntType, {core::IntPtrType, core::IntType}, false)
+    };
+    const static core::Func DotFunc {
+        "vector_dot", FunctionType::get(core::IntType, {core::IntPtrType, core::IntPtrType, core::IntType}, false)
+    };
+    const static core::Func MinFunc {
+        "vector_min", FunctionType::get(core::IntType, {core::IntPtrType, core::IntType}, false)
+    };
+    const static core::Func MaxFunc {
+        "vector_max", FunctionType::get(core::IntType, {core::IntPtrType, core::IntType}, false)
+    };
+    const static core::Func AddFunc {
+        "vector_add", FunctionType::get(core::VoidType, {core::IntPtrType, core::IntPtrType, core::IntPtrType, core::IntType}, false)
+    };
+    const static core::Func ScaleFunc {
+        "vector_scale", FunctionType::get(core::VoidType, {core::IntPtrType, core::IntType, core::IntType}, false)
+    };
+    const static core::Func ScanFunc {
+        "vector_scan", FunctionType::get(core::VoidType, {core::IntPtrType, core::IntType}, false)
+    };
+
+    using Values = std::vector<Value*>;
+    using Lanes = std::function<Value*(Function* f, Value* index, unsigned width)>;
+    using Combine = std::function<Value*(Value* acc, Value* value)>;
+
+    // Emits `for (i = start; i < end; i += step) values = body(i, values)` and returns the final i and values.
+    static std::pair<Value*, Values> CreateLoop(Function* f, const std::string& name, Value* start, Value* end, uint64_t step,
+                                                const Values& initial, const std::function<Values(Value*, const Values&)>& body) {
+        auto before = core::Builder.GetInsertBlock();
+        auto check = core::CreateBasicBlock(name + "_check", f);
+        auto loop = core::CreateBasicBlock(name, f);
+        auto done = core::CreateBasicBlock(name + "_done", f);
+        core::Builder.CreateBr(check);
+
+        core::Builder.SetInsertPoint(check);
+        auto index = core::Builder.CreatePHI(core::IntType, 2);
+        index->addIncoming(start, before);
+        std::vector<PHINode*> phis = {};
+        Values values = {};
+        for (auto value : initial) {
+            auto phi = core::Builder.CreatePHI(value->getType(), 2);
+            phi->addIncoming(value, before);
+            phis.push_back(phi);
+            values.push_back(phi);
+        }
+        core::Builder.CreateCondBr(core::Builder.CreateICmpSLT(index, end), loop, done);
+
+        core::Builder.SetInsertPoint(loop);
+        auto next_values = body(index, values);
+        auto next_index = core::Builder.CreateAdd(index, core::GetInt(step));
+        auto latch = core::Builder.GetInsertBlock();
+        index->addIncoming(next_index, latch);
+        for (size_t i = 0; i < phis.size(); i++) {
+            phis[i]->addIncoming(next_values[i], latch);
+        }
+        core::Builder.CreateBr(check);
+
+        core::Builder.SetInsertPoint(done);
+        return {index, values};
+    }
+
+    static Value* Load(Value* array, Value* index, unsigned width) {
+        auto addr = core::Builder.CreateGEP(array, index);
+        if (width == 1) { return core::Builder.CreateAlignedLoad(addr, CellAlign); }
+        auto vector_addr = core::Builder.CreateBitCast(addr, CellVectorType->getPointerTo());
+        return core::Builder.CreateAlignedLoad(vector_addr, CellAlign);
+    }
+
+    static void Store(Value* value, Value* array, Value* index, unsigned width) {
+        auto addr = core::Builder.CreateGEP(array, index);
+        if (width == 1) {
+            core::Builder.CreateAlignedStore(value, addr, CellAlign);
+        } else {
+            auto vector_addr = core::Builder.CreateBitCast(addr, CellVectorType->getPointerTo());
+            core::Builder.CreateAlignedStore(value, vector_addr, CellAlign);
+        }
+    }
+
+    static Value* GetVectorEnd(Value* n) {
+        return core::Builder.CreateAnd(n, core::GetInt(~(uint64_t)(VectorWidth - 1)));
+    }
+
+    static void CreateReduction(const core::Func& func, Constant* identity, const Lanes& lanes, const Combine& combine) {
+        core::CreateFunction(func, [=](Function* f, BasicBlock* entry) {
+            auto n = f->arg_end() - 1;
+            auto vector_end = GetVectorEnd(n);
+            auto splat = core::Builder.CreateVectorSplat(VectorWidth, identity);
+            auto vector_loop = CreateLoop(f, "vector", core::GetInt(0), vector_end, VectorWidth, {splat},
+                                          [=](Value* index, const Values& acc) -> Values {
+                return {combine(acc[0], lanes(f, index, VectorWidth))};
+            });
+            Value* total = identity;
+            for (unsigned i = 0; i < VectorWidth; i++) {
+                total = combine(total, core::Builder.CreateExtractElement(vector_loop.second[0], core::GetIndex(i)));
+            }
+            auto scalar_loop = CreateLoop(f, "scalar", vector_loop.first, n, 1, {total},
+                                          [=](Value* index, const Values& acc) -> Values {
+                return {combine(acc[0], lanes(f, index, 1))};
+            });
+            core::Builder.CreateRet(scalar_loop.second[0]);
+        });
+    }
+
+    static void CreateMap(const core::Func& func, unsigned n_arg, const std::function<void(Function*, Value*, unsigned)>& body) {
+        core::CreateFunction(func, [=](Function* f, BasicBlock* entry) {
+            auto n = f->arg_begin() + n_arg;
+            auto vector_end = GetVectorEnd(n);
+            auto vector_loop = CreateLoop(f, "vector", core::GetInt(0), vector_end, VectorWidth, {},
+                                          [=](Value* index, const Values&) -> Values {
+                body(f, index, VectorWidth);
+                return {};
+            });
+            CreateLoop(f, "scalar", vector_loop.first, n, 1, {}, [=](Value* index, const Values&) -> Values {
+                body(f, index, 1);
+                return {};
+            });
+            core::Builder.CreateRetVoid();
+        });
+    }
+
+    static Value* Splat(Value* value, unsigned width) {
+        return width == 1 ? value : core::Builder.CreateVectorSplat(width, value);
+    }
+
+    static void Initialize(unsigned cell_align) {
+        CellAlign = cell_align;
+        CreateReduction(SumFunc, core::GetInt(0), [](Function* f, Value* index, unsigned width) {
+            return Load(f->arg_begin(), index, width);
+        }, [](Value* acc, Value* value) {
+            return core::Builder.CreateAdd(acc, value);
+        });
+        CreateReduction(DotFunc, core::GetInt(0), [](Function* f, Value* index, unsigned width) {
+            auto args = f->arg_begin();
+            auto a = args++;
+            auto b = args++;
+            return core::Builder.CreateMul(Load(a, index, width), Load(b, index, width));
+        }, [](Value* acc, Value* value) {
+            return core::Builder.CreateAdd(acc, value);
+        });
+        // An empty array reduces to the identity, INT64_MAX for vmin and INT64_MIN for vmax.
+        CreateReduction(MinFunc, core::GetInt(INT64_MAX), [](Function* f, Value* index, unsigned width) {
+            return Load(f->arg_begin(), index, width);
+        }, [](Value* acc, Value* value) {
+            return core::Builder.CreateSelect(core::Builder.CreateICmpSLT(acc, value), acc, value);
+        });
+        CreateReduction(MaxFunc, core::GetInt(INT64_MIN), [](Function* f, Value* index, unsigned width) {
+            return Load(f->arg_begin(), index, width);
+        }, [](Value* acc, Value* value) {
+            return core::Builder.CreateSelect(core::Builder.CreateICmpSGT(acc, value), acc, value);
+        });
+        CreateMap(AddFunc, 3, [](Function* f, Value* index, unsigned width) {
+            auto args = f->arg_begin();
+            auto a = args++;
+            auto b = args++;
+            auto dst = args++;
+            Store(core::Builder.CreateAdd(Load(a, index, width), Load(b, index, width)), dst, index, width);
+        });
+        CreateMap(ScaleFunc, 1, [](Function* f, Value* index, unsigned width) {
+            auto args = f->arg_begin();
+            auto array = args++;
+            args++;
+            auto k = args++;
+            Store(core::Builder.CreateMul(Load(array, index, width), Splat(k, width)), array, index, width);
+        });
+        core::CreateFunction(ScanFunc, [](Function* f, BasicBlock* entry) {
+            auto args = f->arg_begin();
+            auto array = args++;
+            auto n = args++;
+            CreateLoop(f, "scalar", core::GetInt(0), n, 1, {core::GetInt(0)}, [=](Value* index, const Values& acc) -> Values {
+                auto total = core::Builder.CreateAdd(acc[0], Load(array, index, 1));
+                Store(total, array, index, 1);
+                return {total};
+            });
+            core::Builder.CreateRetVoid();
+        });
+    }
+}
+
+#endif //LLFORTH_KERNEL_H
@@ -4,6 +4,7 @@ extern crate lib;
 use libc::c_char;
 use std::ffi::CString;
 use std::env::args;
+use std::slice;
 
 fn main() {
     let mut inbuf: [c_char; 1024] = [0; 1024];
@@ -14,14 +15,14 @@ fn main() {
     let argc = argv.len();
     let argv = argv.as_ptr();
 
-    let mut inputs: Vec<(CString, i64)> = Vec::new();
+    let mut inputs: Vec<(String, i64)> = Vec::new();
     let mut reader = lib::create_reader(argc, argv);
     loop {
         match lib::read_word_from_reader(reader, inbuf_ptr, 1024) {
             0 => {
                 match inbuf[0] {
                     0 => { // Empty
-                        inputs.push((CString::new("").expect(""), 0));
+                        inputs.push((String::new(), 0));
                     },
                     10 => { // Enter
                         println!(" {:?}", inputs);
@@ -31,8 +32,8 @@ fn main() {
                 }
             },
             len => {
-                let c_word = unsafe { CString::from_raw(inbuf_ptr) };
-                inputs.push((c_word.clone(), len));
+                let bytes = unsafe { slice::from_raw_parts(inbuf_ptr as *const u8, len as usize) };
+                inputs.push((String::from_utf8_lossy(bytes).into_owned(), len));
             },
         }
     }
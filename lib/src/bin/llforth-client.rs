@@ -0,0 +1,55 @@
+//! Runs a script on `llforth --serve`: sends stdin, or the file given after the socket,
+//! prints the output and exits with the exit status of the script.
+
+use std::env;
+use std::fs::File;
+use std::io;
+use std::io::{Read, Write};
+use std::net::Shutdown;
+use std::os::unix::net::UnixStream;
+use std::process;
+
+fn run(socket: &str, file: Option<&str>) -> io::Result<i32> {
+    let mut stream = UnixStream::connect(socket)?;
+    match file {
+        Some(file) => { io::copy(&mut File::open(file)?, &mut stream)?; },
+        None => { io::copy(&mut io::stdin(), &mut stream)?; },
+    }
+    stream.shutdown(Shutdown::Write)?;
+
+    // The last 4 bytes are the exit status, so output is held back by that much
+    let stdout = io::stdout();
+    let mut stdout = stdout.lock();
+    let mut pending: Vec<u8> = Vec::new();
+    let mut buf = [0; 64 * 1024];
+    loop {
+        let n = stream.read(&mut buf)?;
+        if n == 0 { break; }
+        pending.extend_from_slice(&buf[..n]);
+        if pending.len() > 4 {
+            let end = pending.len() - 4;
+            stdout.write_all(&pending[..end])?;
+            pending.drain(..end);
+        }
+    }
+    stdout.flush()?;
+    if pending.len() != 4 {
+        return Err(io::Error::new(io::ErrorKind::UnexpectedEof, "connection closed without an exit status"));
+    }
+    Ok(((pending[0] as i32) << 24) | ((pending[1] as i32) << 16) | ((pending[2] as i32) << 8) | pending[3] as i32)
+}
+
+fn main() {
+    let args: Vec<String> = env::args().collect();
+    if args.len() < 2 || args.len() > 3 {
+        eprintln!("usage: {} SOCKET [FILE]", args[0]);
+        process::exit(2);
+    }
+    match run(&args[1], args.get(2).map(|file| file.as_str())) {
+        Ok(status) => process::exit(status),
+        Err(err) => {
+            eprintln!("llforth-client: {}", err);
+            process::exit(1);
+        },
+    }
+}
@@ -0,0 +1,512 @@
+//! The compiled include cache behind `include`. The first run interprets a source file and
+//! saves what it added to the dictionary to FILE.cache: the cells with their kinds, the new
+//! words and the strings they use. Later runs copy them back instead, as long as the file and
+//! the interpreter are the same. Xts, branch targets and strings are saved relative to where
+//! the file started, and relocated to where the dictionary ends when they are loaded.
+//!
+//! What a file compiles also depends on the files included before it, whose words it may copy
+//! or run while compiling, and on the files it includes itself. A cache records both with their
+//! keys, and is only loaded after the same files and while the files it included are unchanged.
+//! Words created outside any file, e.g. at the prompt, cannot be checked, so once there are any
+//! nothing is cached for the rest of the run.
+
+use std::cell::RefCell;
+use std::ffi::OsString;
+use std::fs;
+use std::fs::File;
+use std::ffi::OsStr;
+use std::io::{Read, Write};
+use std::mem::size_of;
+use std::os::unix::ffi::OsStrExt;
+use std::path::PathBuf;
+use std::ptr;
+use std::slice;
+
+use libc;
+use libc::c_char;
+
+use file::{error_code, path};
+use reader::Reader;
+
+const MAGIC: i64 = 0x3263_6874_726f_666c; // "lforth2c"
+
+// Cell kinds of dict_kinds and pool_kinds, see dict::CellKind
+const RAW: u8 = 0;
+const XT: u8 = 1;
+const TARGET: u8 = 2;
+const STRING: u8 = 3;
+const POOL: u8 = 4;
+
+#[repr(C)]
+pub struct Xt {
+    addr: *const u8,
+    colon: u32,
+}
+
+#[repr(C)]
+pub struct Header {
+    prev: *mut Xt,
+    word: *const u8,
+    length: i64,
+    immediate: u8,
+    inline: u32,
+}
+
+/// Where the VM keeps its dictionary, filled in by cache.h as include_image.
+#[repr(C)]
+pub struct Image {
+    memory: *mut u8,
+    kinds: *mut u8,
+    here: *mut u32,
+    memory_size: i64,
+    cell_size: i64,
+    pool: *mut i64,
+    pool_kinds: *mut u8,
+    pool_count: *mut u32,
+    pool_size: i64,
+    xts: *mut Xt,
+    headers: *mut Header,
+    word_count: *mut u32,
+    last_xt: *mut *mut Xt,
+    max_words: i64,
+    find_cache: *mut *mut Xt,
+    find_cache_size: i64,
+    strings: *mut u8,
+    strings_here: *mut i64,
+    strings_size: i64,
+    docol: *const u8,
+    version: i64,
+    fence: *const u32,
+}
+
+impl Image {
+    fn tokens(&self) -> bool {
+        self.cell_size == 4
+    }
+
+    unsafe fn cell(&self, index: i64) -> i64 {
+        let at = self.memory.offset((index * self.cell_size) as isize);
+        if self.tokens() { *(at as *const i32) as i64 } else { *(at as *const i64) }
+    }
+
+    // With tokens, the data cell , wrote at index across it and the next code cell
+    unsafe fn wide_cell(&self, index: i64) -> i64 {
+        self.cell(index) as u32 as i64 | self.cell(index + 1) << 32
+    }
+
+    unsafe fn set_cell(&self, index: i64, value: i64) {
+        let at = self.memory.offset((index * self.cell_size) as isize);
+        if self.tokens() { *(at as *mut i32) = value as i32 } else { *(at as *mut i64) = value }
+    }
+
+    unsafe fn xt(&self, index: i64) -> *mut Xt {
+        self.xts.offset(index as isize)
+    }
+
+    fn xt_index(&self, xt: i64) -> i64 {
+        (xt - self.xts as i64) / size_of::<Xt>() as i64
+    }
+
+    unsafe fn name(&self, index: i64) -> &[u8] {
+        let header = &*self.headers.offset(index as isize);
+        if header.word.is_null() { &[] } else { slice::from_raw_parts(header.word, header.length as usize) }
+    }
+
+    // Whether a raw value is an address into the dictionary, which could not be relocated
+    fn is_address(&self, value: i64) -> bool {
+        let within = |start: *const u8, size: i64| value >= start as i64 && value < start as i64 + size;
+        within(self.memory, self.memory_size * self.cell_size)
+            || within(self.xts as *const u8, self.max_words * size_of::<Xt>() as i64)
+            || within(self.headers as *const u8, self.max_words * size_of::<Header>() as i64)
+            || within(self.strings, self.strings_size)
+    }
+}
+
+// Where the dictionary stood when a file started being interpreted
+struct Frame {
+    cache: PathBuf,
+    key: i64,
+    depth: usize,
+    here: i64,
+    words: i64,
+    strings: i64,
+    files: usize,
+}
+
+// A file compiled into the dictionary and the key of its text
+type Source = (Vec<u8>, i64);
+
+struct Includes {
+    frames: Vec<Frame>,
+    // Every file include started, in order, whether it was interpreted or loaded
+    files: Vec<Source>,
+    // The words when an include last started or ended, None before the first
+    words: Option<i64>,
+    // Set once the dictionary has words which did not come from a file
+    tainted: bool,
+}
+
+thread_local!(static INCLUDES: RefCell<Includes> = RefCell::new(Includes {
+    frames: Vec::new(),
+    files: Vec::new(),
+    words: None,
+    tainted: false,
+}));
+
+// The key of the file name now, or None when it cannot be read
+fn file_key(version: i64, name: &[u8]) -> Option<i64> {
+    let mut text = Vec::new();
+    File::open(OsStr::from_bytes(name)).and_then(|mut file| file.read_to_end(&mut text)).ok()?;
+    Some(hash(version, &text))
+}
+
+fn hash(version: i64, text: &[u8]) -> i64 {
+    let mut hash: u64 = 0xcbf2_9ce4_8422_2325;
+    let version = (0..8).map(|i| (version >> (i * 8)) as u8);
+    for byte in version.chain(text.iter().cloned()) {
+        hash = (hash ^ byte as u64).wrapping_mul(0x100_0000_01b3);
+    }
+    hash as i64
+}
+
+struct Output {
+    data: Vec<u8>,
+}
+
+impl Output {
+    fn put(&mut self, value: i64) {
+        for i in 0..8 {
+            self.data.push((value >> (i * 8)) as u8);
+        }
+    }
+
+    fn put_bytes(&mut self, bytes: &[u8]) {
+        self.put(bytes.len() as i64);
+        self.data.extend_from_slice(bytes);
+    }
+
+    fn put_sources(&mut self, sources: &[Source]) {
+        self.put(sources.len() as i64);
+        for &(ref name, key) in sources {
+            self.put_bytes(name);
+            self.put(key);
+        }
+    }
+}
+
+struct Input<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Input<'a> {
+    fn get(&mut self) -> Option<i64> {
+        let bytes = self.data.get(self.pos..self.pos + 8)?;
+        self.pos += 8;
+        Some(bytes.iter().rev().fold(0, |value, &byte| value << 8 | byte as i64))
+    }
+
+    fn get_bytes(&mut self) -> Option<&'a [u8]> {
+        let len = self.get()? as usize;
+        let bytes = self.data.get(self.pos..self.pos + len)?;
+        self.pos += len;
+        Some(bytes)
+    }
+
+    fn get_sources(&mut self) -> Option<Vec<Source>> {
+        let mut sources = Vec::new();
+        for _ in 0..self.get()? {
+            sources.push((self.get_bytes()?.to_vec(), self.get()?));
+        }
+        Some(sources)
+    }
+}
+
+// What a cache file says about a word, colon and name relative to the file's start
+struct Word {
+    colon: i64,
+    immediate: i64,
+    inline: i64,
+    name: i64,
+    length: i64,
+}
+
+// Xts of words the file created are saved as -1 - their order, the others as their index,
+// whose names are checked again before loading
+fn save_xt(image: &Image, frame: &Frame, index: i64, externals: &mut Vec<i64>) -> Option<i64> {
+    let words = unsafe { *image.word_count } as i64;
+    if index >= frame.words && index < words {
+        return Some(-1 - (index - frame.words));
+    }
+    if index < 0 || index >= frame.words {
+        return None;
+    }
+    if !externals.contains(&index) {
+        externals.push(index);
+    }
+    Some(index)
+}
+
+fn save_string(image: &Image, frame: &Frame, value: i64) -> Option<i64> {
+    let offset = value - (image.strings as i64 + frame.strings);
+    if offset < 0 || offset > unsafe { *image.strings_here } - frame.strings {
+        return None;
+    }
+    Some(offset)
+}
+
+// The cache of what was compiled since frame, or None if something cannot be relocated
+unsafe fn save(image: &Image, frame: &Frame, files: &[Source]) -> Option<Vec<u8>> {
+    let here = *image.here as i64;
+    let words = *image.word_count as i64;
+    let strings = *image.strings_here;
+    if here < frame.here || words < frame.words || strings < frame.strings {
+        return None;
+    }
+    let mut externals = Vec::new();
+    let mut cells = Output { data: Vec::new() };
+    cells.put(here - frame.here);
+    for index in frame.here..here {
+        let kind = *image.kinds.offset(index as isize);
+        let value = image.cell(index);
+        let (kind, value) = match kind {
+            RAW if !image.tokens() && image.is_address(value) => return None,
+            // Any two raw code cells may hold a data cell, so every pair is checked
+            RAW if image.tokens() && index + 1 < here && *image.kinds.offset(index as isize + 1) == RAW
+                && image.is_address(image.wide_cell(index)) => return None,
+            RAW => (RAW, value),
+            XT => {
+                let xt = if image.tokens() { value } else { image.xt_index(value) };
+                (XT, save_xt(image, frame, xt, &mut externals)?)
+            },
+            TARGET if image.tokens() => (TARGET, value),
+            TARGET if value >= frame.here && value <= here => (TARGET, value - frame.here),
+            STRING => (STRING, save_string(image, frame, value)?),
+            POOL => {
+                let sub = *image.pool_kinds.offset(value as isize);
+                let value = *image.pool.offset(value as isize);
+                let value = match sub {
+                    RAW if image.is_address(value) => return None,
+                    RAW => value,
+                    XT => save_xt(image, frame, image.xt_index(value), &mut externals)?,
+                    STRING => save_string(image, frame, value)?,
+                    _ => return None,
+                };
+                (POOL | sub << 4, value)
+            },
+            _ => return None,
+        };
+        cells.put(kind as i64);
+        cells.put(value);
+    }
+    cells.put(words - frame.words);
+    for index in frame.words..words {
+        let xt = &*image.xt(index);
+        let header = &*image.headers.offset(index as isize);
+        let colon = xt.colon as i64 - frame.here;
+        if xt.addr != image.docol || colon < 0 || colon > here - frame.here {
+            return None;
+        }
+        cells.put(colon);
+        cells.put(header.immediate as i64);
+        cells.put(header.inline as i64);
+        cells.put(save_string(image, frame, header.word as i64)?);
+        cells.put(header.length);
+    }
+
+    let mut out = Output { data: Vec::new() };
+    out.put(MAGIC);
+    out.put(frame.key);
+    out.put(image.cell_size);
+    out.put_sources(&files[..frame.files]);
+    out.put_sources(&files[frame.files + 1..]);
+    out.put(externals.len() as i64);
+    for &index in &externals {
+        out.put(index);
+        out.put_bytes(image.name(index));
+    }
+    out.put_bytes(slice::from_raw_parts(image.strings.offset(frame.strings as isize), (strings - frame.strings) as usize));
+    out.data.extend(cells.data);
+    Some(out.data)
+}
+
+// Appends the cache in data to the dictionary after files, unless it is stale or does not
+// fit, and returns the files it included
+unsafe fn load(image: &Image, key: i64, files: &[Source], data: &[u8]) -> Option<Vec<Source>> {
+    let mut input = Input { data, pos: 0 };
+    if input.get()? != MAGIC || input.get()? != key || input.get()? != image.cell_size {
+        return None;
+    }
+    if input.get_sources()?.as_slice() != files {
+        return None;
+    }
+    let included = input.get_sources()?;
+    if included.iter().any(|&(ref name, key)| file_key(image.version, name) != Some(key)) {
+        return None;
+    }
+    let words = *image.word_count as i64;
+    for _ in 0..input.get()? {
+        let index = input.get()?;
+        let name = input.get_bytes()?;
+        if index < 0 || index >= words || image.name(index) != name {
+            return None;
+        }
+    }
+    let strings = input.get_bytes()?;
+    let mut cells = Vec::new();
+    for _ in 0..input.get()? {
+        cells.push((input.get()? as u8, input.get()?));
+    }
+    let mut new_words = Vec::new();
+    for _ in 0..input.get()? {
+        new_words.push(Word {
+            colon: input.get()?,
+            immediate: input.get()?,
+            inline: input.get()?,
+            name: input.get()?,
+            length: input.get()?,
+        });
+    }
+    let pooled = cells.iter().filter(|&&(kind, _)| kind & 0xf == POOL).count() as i64;
+    let base = *image.here as i64;
+    let string_base = *image.strings_here;
+    if base + cells.len() as i64 > image.memory_size
+        || words + new_words.len() as i64 > image.max_words
+        || string_base + strings.len() as i64 > image.strings_size
+        || (pooled > 0 && *image.pool_count as i64 + pooled > image.pool_size) {
+        return None;
+    }
+
+    let string_start = image.strings as i64 + string_base;
+    let string = |offset: i64| string_start + offset;
+    let xt = |value: i64| if value < 0 { words - 1 - value } else { value };
+    ptr::copy_nonoverlapping(strings.as_ptr(), image.strings.offset(string_base as isize), strings.len());
+    for (i, &(kind, value)) in cells.iter().enumerate() {
+        let index = base + i as i64;
+        let (kind, sub) = (kind & 0xf, kind >> 4);
+        let cell = match kind {
+            XT if image.tokens() => xt(value),
+            XT => image.xt(xt(value)) as i64,
+            TARGET if image.tokens() => value,
+            TARGET => base + value,
+            STRING => string(value),
+            POOL => {
+                let pool = *image.pool_count as i64;
+                *image.pool.offset(pool as isize) = match sub {
+                    XT => image.xt(xt(value)) as i64,
+                    STRING => string(value),
+                    _ => value,
+                };
+                *image.pool_kinds.offset(pool as isize) = sub;
+                *image.pool_count += 1;
+                pool
+            },
+            _ => value,
+        };
+        image.set_cell(index, cell);
+        *image.kinds.offset(index as isize) = kind;
+    }
+    for (i, word) in new_words.iter().enumerate() {
+        let index = words + i as i64;
+        *image.xt(index) = Xt { addr: image.docol, colon: (base + word.colon) as u32 };
+        *image.headers.offset(index as isize) = Header {
+            prev: *image.last_xt,
+            word: string(word.name) as *const u8,
+            length: word.length,
+            immediate: word.immediate as u8,
+            inline: word.inline as u32,
+        };
+        *image.last_xt = image.xt(index);
+    }
+    *image.here = (base + cells.len() as i64) as u32;
+    *image.word_count = (words + new_words.len() as i64) as u32;
+    *image.strings_here = string_base + strings.len() as i64;
+    // Loaded words may shadow the cached ones
+    for i in 0..image.find_cache_size {
+        *image.find_cache.offset(i as isize) = ptr::null_mut();
+    }
+    Some(included)
+}
+
+/// Includes the file `name`: returns 0 when it was loaded from its cache, or -1 after making
+/// `reader` read it, so that the interpreter compiles it and `include_end` saves the cache.
+/// Returns the error code when the file cannot be read.
+#[no_mangle]
+pub extern "C" fn include_begin(reader: *mut Reader, image: *const Image, name: *const c_char, len: i64) -> i64 {
+    let reader = unsafe { &mut *reader };
+    let image = unsafe { &*image };
+    let source = unsafe { path(name, len) };
+    let mut text = Vec::new();
+    if let Err(err) = File::open(source).and_then(|mut file| file.read_to_end(&mut text)) {
+        return match error_code(&err) {
+            code if code > 0 => code,
+            _ => libc::EIO as i64,
+        };
+    }
+    let key = hash(image.version, &text);
+    let mut cache = OsString::from(source);
+    cache.push(".cache");
+    let cache = PathBuf::from(cache);
+    let depth = reader.depth();
+    INCLUDES.with(|includes| {
+        let includes = &mut *includes.borrow_mut();
+        let words = unsafe { *image.word_count } as i64;
+        // Files left by a throw were dropped by the reader, so are their frames, and nobody
+        // knows what they compiled. Words created between files came from somewhere else.
+        let frames = includes.frames.len();
+        includes.frames.retain(|frame| frame.depth <= depth);
+        let last = includes.words.unwrap_or(unsafe { *image.fence } as i64);
+        if includes.frames.len() != frames || (includes.frames.is_empty() && words != last) {
+            includes.tainted = true;
+        }
+        includes.files.push((source.as_bytes().to_vec(), key));
+
+        let mut data = Vec::new();
+        if !includes.tainted && File::open(&cache).and_then(|mut file| file.read_to_end(&mut data)).is_ok() {
+            let files = &includes.files[..includes.files.len() - 1];
+            if let Some(included) = unsafe { load(image, key, files, &data) } {
+                includes.files.extend(included);
+                includes.words = Some(unsafe { *image.word_count } as i64);
+                return 0;
+            }
+        }
+        reader.evaluate(&text);
+        includes.frames.push(Frame {
+            cache,
+            key,
+            depth: depth + 1,
+            here: unsafe { *image.here } as i64,
+            words,
+            strings: unsafe { *image.strings_here },
+            files: includes.files.len() - 1,
+        });
+        includes.words = Some(words);
+        -1
+    })
+}
+
+/// Saves what the innermost file being included compiled to its cache, if it can be
+/// relocated. A cache which cannot be written is only a missed optimization.
+#[no_mangle]
+pub extern "C" fn include_end(image: *const Image) {
+    let image = unsafe { &*image };
+    INCLUDES.with(|includes| {
+        let includes = &mut *includes.borrow_mut();
+        includes.words = Some(unsafe { *image.word_count } as i64);
+        let frame = match includes.frames.pop() {
+            Some(frame) => frame,
+            None => return,
+        };
+        if includes.tainted {
+            return;
+        }
+        if let Some(data) = unsafe { save(image, &frame, &includes.files) } {
+            let mut temp = frame.cache.clone().into_os_string();
+            temp.push(".tmp");
+            let written = File::create(&temp).and_then(|mut file| file.write_all(&data));
+            if written.and_then(|_| fs::rename(&temp, &frame.cache)).is_err() {
+                let _ = fs::remove_file(&temp);
+            }
+        }
+    });
+}
@@ -0,0 +1,328 @@
+use std::cell::RefCell;
+use std::io;
+use std::os::unix::io::IntoRawFd;
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::ptr;
+
+use libc;
+use libc::{c_char, c_int};
+
+use file::{error_code, path, set};
+
+pub const READABLE: i64 = 1;
+pub const WRITABLE: i64 = 2;
+const MAX_EVENTS: usize = 256;
+
+fn last_error() -> i64 {
+    error_code(&io::Error::last_os_error())
+}
+
+fn result(ret: c_int) -> io::Result<c_int> {
+    if ret < 0 { Err(io::Error::last_os_error()) } else { Ok(ret) }
+}
+
+fn set_nonblocking(fd: c_int) -> io::Result<()> {
+    let flags = result(unsafe { libc::fcntl(fd, libc::F_GETFL) })?;
+    result(unsafe { libc::fcntl(fd, libc::F_SETFL, flags | libc::O_NONBLOCK) })?;
+    Ok(())
+}
+
+#[cfg(target_os = "linux")]
+mod poller {
+    use std::io;
+    use libc;
+    use libc::c_int;
+    use super::{result, READABLE, WRITABLE, MAX_EVENTS};
+
+    pub struct Poller {
+        epoll: c_int,
+        events: Vec<libc::epoll_event>,
+    }
+
+    fn interest(events: i64) -> u32 {
+        let mut flags = 0;
+        if events & READABLE != 0 { flags |= libc::EPOLLIN; }
+        if events & WRITABLE != 0 { flags |= libc::EPOLLOUT; }
+        flags as u32
+    }
+
+    impl Poller {
+        pub fn new() -> io::Result<Poller> {
+            let epoll = result(unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) })?;
+            Ok(Poller { epoll, events: vec![libc::epoll_event { events: 0, u64: 0 }; MAX_EVENTS] })
+        }
+
+        pub fn watch(&mut self, fd: c_int, events: i64) -> io::Result<()> {
+            let mut event = libc::epoll_event { events: interest(events), u64: fd as u64 };
+            match result(unsafe { libc::epoll_ctl(self.epoll, libc::EPOLL_CTL_ADD, fd, &mut event) }) {
+                Err(ref err) if err.raw_os_error() == Some(libc::EEXIST) => {
+                    result(unsafe { libc::epoll_ctl(self.epoll, libc::EPOLL_CTL_MOD, fd, &mut event) })?;
+                },
+                other => { other?; },
+            }
+            Ok(())
+        }
+
+        pub fn unwatch(&mut self, fd: c_int) -> io::Result<()> {
+            let mut event = libc::epoll_event { events: 0, u64: 0 };
+            result(unsafe { libc::epoll_ctl(self.epoll, libc::EPOLL_CTL_DEL, fd, &mut event) })?;
+            Ok(())
+        }
+
+        pub fn wait(&mut self, timeout: c_int, ready: &mut Vec<(i64, i64)>) -> io::Result<()> {
+            let n = result(unsafe {
+                libc::epoll_wait(self.epoll, self.events.as_mut_ptr(), self.events.len() as c_int, timeout)
+            })?;
+            for event in &self.events[..n as usize] {
+                let flags = event.events as c_int;
+                let mut events = 0;
+                if flags & (libc::EPOLLIN | libc::EPOLLHUP | libc::EPOLLERR) != 0 { events |= READABLE; }
+                if flags & (libc::EPOLLOUT | libc::EPOLLERR) != 0 { events |= WRITABLE; }
+                ready.push((event.u64 as i64, events));
+            }
+            Ok(())
+        }
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod poller {
+    use std::io;
+    use libc;
+    use libc::c_int;
+    use super::{result, READABLE, WRITABLE, MAX_EVENTS};
+
+    pub struct Poller {
+        fds: Vec<libc::pollfd>,
+    }
+
+    fn interest(events: i64) -> i16 {
+        let mut flags = 0;
+        if events & READABLE != 0 { flags |= libc::POLLIN; }
+        if events & WRITABLE != 0 { flags |= libc::POLLOUT; }
+        flags
+    }
+
+    impl Poller {
+        pub fn new() -> io::Result<Poller> {
+            Ok(Poller { fds: Vec::new() })
+        }
+
+        pub fn watch(&mut self, fd: c_int, events: i64) -> io::Result<()> {
+            match self.fds.iter_mut().find(|pollfd| pollfd.fd == fd) {
+                Some(pollfd) => pollfd.events = interest(events),
+                None => self.fds.push(libc::pollfd { fd, events: interest(events), revents: 0 }),
+            }
+            Ok(())
+        }
+
+        pub fn unwatch(&mut self, fd: c_int) -> io::Result<()> {
+            match self.fds.iter().position(|pollfd| pollfd.fd == fd) {
+                Some(index) => { self.fds.swap_remove(index); Ok(()) },
+                None => Err(io::Error::from_raw_os_error(libc::ENOENT)),
+            }
+        }
+
+        pub fn wait(&mut self, timeout: c_int, ready: &mut Vec<(i64, i64)>) -> io::Result<()> {
+            result(unsafe { libc::poll(self.fds.as_mut_ptr(), self.fds.len() as libc::nfds_t, timeout) })?;
+            for pollfd in self.fds.iter().filter(|pollfd| pollfd.revents != 0).take(MAX_EVENTS) {
+                let mut events = 0;
+                if pollfd.revents & (libc::POLLIN | libc::POLLHUP | libc::POLLERR) != 0 { events |= READABLE; }
+                if pollfd.revents & (libc::POLLOUT | libc::POLLERR) != 0 { events |= WRITABLE; }
+                ready.push((pollfd.fd as i64, events));
+            }
+            Ok(())
+        }
+    }
+}
+
+/// The process wide event loop. `event_wait` fills `ready` with a batch of up to
+/// MAX_EVENTS completions, which `event_get` then reads without further syscalls.
+struct EventLoop {
+    poller: poller::Poller,
+    ready: Vec<(i64, i64)>,
+}
+
+thread_local!(static EVENT_LOOP: RefCell<Option<EventLoop>> = RefCell::new(None));
+
+/// Runs `f` on the event loop, which is created on first use.
+fn with_event_loop<T, F: FnOnce(&mut EventLoop) -> io::Result<T>>(f: F) -> io::Result<T> {
+    EVENT_LOOP.with(|cell| {
+        let mut event_loop = cell.borrow_mut();
+        if event_loop.is_none() {
+            *event_loop = Some(EventLoop { poller: poller::Poller::new()?, ready: Vec::with_capacity(MAX_EVENTS) });
+        }
+        f(event_loop.as_mut().unwrap())
+    })
+}
+
+fn to_ior(result: io::Result<()>) -> i64 {
+    match result {
+        Ok(_) => 0,
+        Err(err) => error_code(&err),
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn would_block() -> i64 {
+    libc::EAGAIN as i64
+}
+
+#[no_mangle]
+pub extern "C" fn fd_nonblock(fd: i64) -> i64 {
+    to_ior(set_nonblocking(fd as c_int))
+}
+
+/// Reads what is available now. `ior` is would_block() when nothing is.
+#[no_mangle]
+pub extern "C" fn fd_read(fd: i64, buf: *mut c_char, len: i64, ior: *mut i64) -> i64 {
+    loop {
+        let n = unsafe { libc::read(fd as c_int, buf as *mut libc::c_void, len as usize) };
+        if n >= 0 {
+            unsafe { set(ior, 0) };
+            return n as i64;
+        }
+        let code = last_error();
+        if code != libc::EINTR as i64 {
+            unsafe { set(ior, code) };
+            return 0;
+        }
+    }
+}
+
+/// Writes what fits now, which may be less than `len`. `ior` is would_block() when nothing fits.
+#[no_mangle]
+pub extern "C" fn fd_write(fd: i64, buf: *const c_char, len: i64, ior: *mut i64) -> i64 {
+    loop {
+        let n = unsafe { libc::write(fd as c_int, buf as *const libc::c_void, len as usize) };
+        if n >= 0 {
+            unsafe { set(ior, 0) };
+            return n as i64;
+        }
+        let code = last_error();
+        if code != libc::EINTR as i64 {
+            unsafe { set(ior, code) };
+            return 0;
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn fd_close(fd: i64) -> i64 {
+    // Without a loop nothing is watched, so there is no need to create one
+    EVENT_LOOP.with(|cell| {
+        if let Some(ref mut event_loop) = *cell.borrow_mut() {
+            let _ = event_loop.poller.unwatch(fd as c_int);
+        }
+    });
+    match unsafe { libc::close(fd as c_int) } {
+        0 => 0,
+        _ => last_error(),
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn fd_pipe(read_fd: *mut i64, write_fd: *mut i64) -> i64 {
+    let mut fds: [c_int; 2] = [-1, -1];
+    let created = result(unsafe { libc::pipe(fds.as_mut_ptr()) }).and_then(|_| {
+        set_nonblocking(fds[0])?;
+        set_nonblocking(fds[1])
+    });
+    unsafe {
+        set(read_fd, fds[0] as i64);
+        set(write_fd, fds[1] as i64);
+    }
+    to_ior(created)
+}
+
+#[no_mangle]
+pub extern "C" fn unix_connect(name: *const c_char, len: i64, ior: *mut i64) -> i64 {
+    let connected = UnixStream::connect(unsafe { path(name, len) })
+        .and_then(|stream| stream.set_nonblocking(true).map(|_| stream));
+    match connected {
+        Ok(stream) => {
+            unsafe { set(ior, 0) };
+            stream.into_raw_fd() as i64
+        },
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            -1
+        },
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn unix_listen(name: *const c_char, len: i64, ior: *mut i64) -> i64 {
+    let bound = UnixListener::bind(unsafe { path(name, len) })
+        .and_then(|listener| listener.set_nonblocking(true).map(|_| listener));
+    match bound {
+        Ok(listener) => {
+            unsafe { set(ior, 0) };
+            listener.into_raw_fd() as i64
+        },
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            -1
+        },
+    }
+}
+
+/// Accepts a pending connection as a nonblocking fd. `ior` is would_block() when none is pending.
+#[no_mangle]
+pub extern "C" fn unix_accept(fd: i64, ior: *mut i64) -> i64 {
+    let accepted = result(unsafe { libc::accept(fd as c_int, ptr::null_mut(), ptr::null_mut()) })
+        .and_then(|client| set_nonblocking(client).map(|_| client));
+    match accepted {
+        Ok(client) => {
+            unsafe { set(ior, 0) };
+            client as i64
+        },
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            -1
+        },
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn event_watch(fd: i64, events: i64) -> i64 {
+    to_ior(with_event_loop(|event_loop| event_loop.poller.watch(fd as c_int, events)))
+}
+
+#[no_mangle]
+pub extern "C" fn event_unwatch(fd: i64) -> i64 {
+    to_ior(with_event_loop(|event_loop| event_loop.poller.unwatch(fd as c_int)))
+}
+
+/// Waits up to `timeout` ms (-1 forever) and returns how many fds are ready.
+#[no_mangle]
+pub extern "C" fn event_wait(timeout: i64, ior: *mut i64) -> i64 {
+    let waited = with_event_loop(|event_loop| {
+        event_loop.ready.clear();
+        event_loop.poller.wait(timeout as c_int, &mut event_loop.ready)?;
+        Ok(event_loop.ready.len() as i64)
+    });
+    match waited {
+        Ok(n) => {
+            unsafe { set(ior, 0) };
+            n
+        },
+        Err(ref err) if err.raw_os_error() == Some(libc::EINTR) => {
+            unsafe { set(ior, 0) };
+            0
+        },
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            0
+        },
+    }
+}
+
+/// Returns the fd of the i-th ready entry of the last wait and stores its events.
+#[no_mangle]
+pub extern "C" fn event_get(index: i64, events: *mut i64) -> i64 {
+    let entry = with_event_loop(|event_loop| Ok(event_loop.ready.get(index as usize).cloned())).unwrap_or(None);
+    let (fd, ready) = entry.unwrap_or((-1, 0));
+    unsafe { set(events, ready) };
+    fd
+}
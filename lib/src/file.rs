@@ -0,0 +1,229 @@
+use std::fs::{File, OpenOptions};
+use std::io;
+use std::io::{BufRead, BufReader, Read, Seek, SeekFrom, Write};
+use std::ffi::OsStr;
+use std::os::unix::ffi::OsStrExt;
+use std::os::unix::io::AsRawFd;
+use std::ptr;
+use std::slice;
+
+use libc;
+use libc::c_char;
+
+pub const READ_ONLY: i64 = 0;
+pub const WRITE_ONLY: i64 = 1;
+pub const READ_WRITE: i64 = 2;
+
+pub struct FileHandle {
+    reader: BufReader<File>,
+}
+
+pub(crate) fn error_code(err: &io::Error) -> i64 {
+    match err.raw_os_error() {
+        Some(code) => code as i64,
+        None => -1,
+    }
+}
+
+pub(crate) unsafe fn path<'a>(name: *const c_char, len: i64) -> &'a OsStr {
+    OsStr::from_bytes(slice::from_raw_parts(name as *const u8, len as usize))
+}
+
+pub(crate) unsafe fn set(out: *mut i64, value: i64) {
+    if !out.is_null() {
+        *out = value;
+    }
+}
+
+fn options(fam: i64) -> OpenOptions {
+    let mut options = OpenOptions::new();
+    match fam {
+        WRITE_ONLY => options.write(true),
+        READ_WRITE => options.read(true).write(true),
+        _ => options.read(true),
+    };
+    options
+}
+
+fn open(options: &OpenOptions, name: &OsStr, ior: *mut i64) -> *mut FileHandle {
+    match options.open(name) {
+        Ok(file) => {
+            unsafe { set(ior, 0) };
+            Box::into_raw(Box::new(FileHandle { reader: BufReader::new(file) }))
+        },
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            ptr::null_mut()
+        },
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn open_file(name: *const c_char, len: i64, fam: i64, ior: *mut i64) -> *mut FileHandle {
+    open(&options(fam), unsafe { path(name, len) }, ior)
+}
+
+#[no_mangle]
+pub extern "C" fn create_file(name: *const c_char, len: i64, fam: i64, ior: *mut i64) -> *mut FileHandle {
+    let mut options = options(fam);
+    options.write(true).create(true).truncate(true);
+    open(&options, unsafe { path(name, len) }, ior)
+}
+
+#[no_mangle]
+pub extern "C" fn close_file(handle: *mut FileHandle) -> i64 {
+    if handle.is_null() {
+        return libc::EBADF as i64;
+    }
+    let mut handle = unsafe { Box::from_raw(handle) };
+    match handle.reader.get_mut().flush() {
+        Ok(_) => 0,
+        Err(err) => error_code(&err),
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn read_file(handle: *mut FileHandle, buf: *mut c_char, len: i64, ior: *mut i64) -> i64 {
+    if handle.is_null() {
+        unsafe { set(ior, libc::EBADF as i64) };
+        return 0;
+    }
+    let handle = unsafe { &mut *handle };
+    let buf = unsafe { slice::from_raw_parts_mut(buf as *mut u8, len as usize) };
+    let mut read = 0;
+    while read < buf.len() {
+        match handle.reader.read(&mut buf[read..]) {
+            Ok(0) => break,
+            Ok(n) => read += n,
+            Err(ref err) if err.kind() == io::ErrorKind::Interrupted => continue,
+            Err(err) => {
+                unsafe { set(ior, error_code(&err)) };
+                return read as i64;
+            },
+        }
+    }
+    unsafe { set(ior, 0) };
+    read as i64
+}
+
+/// Reads up to `len` bytes of the next line, excluding the line terminator.
+/// `flag` is set to false only when the end of file was reached before any byte.
+#[no_mangle]
+pub extern "C" fn read_line(handle: *mut FileHandle, buf: *mut c_char, len: i64, flag: *mut i64, ior: *mut i64) -> i64 {
+    unsafe { set(flag, 0) };
+    if handle.is_null() {
+        unsafe { set(ior, libc::EBADF as i64) };
+        return 0;
+    }
+    let handle = unsafe { &mut *handle };
+    let buf = unsafe { slice::from_raw_parts_mut(buf as *mut u8, len as usize) };
+    let mut read = 0;
+    let mut found = false;
+    loop {
+        let (consumed, done) = {
+            let available = match handle.reader.fill_buf() {
+                Ok(available) => available,
+                Err(ref err) if err.kind() == io::ErrorKind::Interrupted => continue,
+                Err(err) => {
+                    unsafe { set(ior, error_code(&err)) };
+                    return read as i64;
+                },
+            };
+            if available.is_empty() {
+                break;
+            }
+            found = true;
+            let room = buf.len() - read;
+            match available.iter().take(room).position(|&c| c == b'\n') {
+                Some(index) => {
+                    buf[read..read + index].copy_from_slice(&available[..index]);
+                    read += index;
+                    (index + 1, true)
+                },
+                None => {
+                    let n = available.len().min(room);
+                    buf[read..read + n].copy_from_slice(&available[..n]);
+                    read += n;
+                    (n, read == buf.len())
+                },
+            }
+        };
+        handle.reader.consume(consumed);
+        if done {
+            break;
+        }
+    }
+    if read > 0 && buf[read - 1] == b'\r' {
+        read -= 1;
+    }
+    unsafe {
+        set(flag, if found { -1 } else { 0 });
+        set(ior, 0);
+    }
+    read as i64
+}
+
+#[no_mangle]
+pub extern "C" fn write_file(handle: *mut FileHandle, buf: *const c_char, len: i64) -> i64 {
+    if handle.is_null() {
+        return libc::EBADF as i64;
+    }
+    let handle = unsafe { &mut *handle };
+    let buf = unsafe { slice::from_raw_parts(buf as *const u8, len as usize) };
+    // The file offset is past what the reader buffered, so write where reading left off
+    let unread = handle.reader.buffer().len();
+    if unread > 0 {
+        if let Err(err) = handle.reader.get_mut().seek(SeekFrom::Current(-(unread as i64))) {
+            return error_code(&err);
+        }
+        handle.reader.consume(unread);
+    }
+    match handle.reader.get_mut().write_all(buf) {
+        Ok(_) => 0,
+        Err(err) => error_code(&err),
+    }
+}
+
+/// Maps the whole file read-only and returns its address; the mapping outlives the file descriptor.
+#[no_mangle]
+pub extern "C" fn map_file(name: *const c_char, len: i64, size: *mut i64, ior: *mut i64) -> *mut c_char {
+    unsafe { set(size, 0) };
+    let file = match File::open(unsafe { path(name, len) }) {
+        Ok(file) => file,
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            return ptr::null_mut();
+        },
+    };
+    let length = match file.metadata() {
+        Ok(metadata) => metadata.len() as usize,
+        Err(err) => {
+            unsafe { set(ior, error_code(&err)) };
+            return ptr::null_mut();
+        },
+    };
+    unsafe { set(ior, 0) };
+    if length == 0 {
+        return ptr::null_mut();
+    }
+    let addr = unsafe {
+        libc::mmap(ptr::null_mut(), length, libc::PROT_READ, libc::MAP_PRIVATE, file.as_raw_fd(), 0)
+    };
+    if addr == libc::MAP_FAILED {
+        unsafe { set(ior, error_code(&io::Error::last_os_error())) };
+        return ptr::null_mut();
+    }
+    unsafe { set(size, length as i64) };
+    addr as *mut c_char
+}
+
+#[no_mangle]
+pub extern "C" fn unmap_file(addr: *mut c_char, len: i64) -> i64 {
+    if addr.is_null() || len == 0 {
+        return 0;
+    }
+    match unsafe { libc::munmap(addr as *mut libc::c_void, len as usize) } {
+        0 => 0,
+        _ => error_code(&io::Error::last_os_error()),
+    }
+}
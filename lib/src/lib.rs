@@ -4,16 +4,28 @@ extern crate libc;
 extern crate clap;
 
 use libc::c_char;
-use std::ffi::{CString, CStr};
+use std::ffi::CStr;
 use std::slice;
+use std::str;
+use std::env;
+use std::process;
+use std::ptr;
+use std::fs::File;
+use std::os::unix::io::IntoRawFd;
 use std::mem::transmute;
+use std::sync::atomic::{AtomicUsize, Ordering};
 use clap::{App, Arg};
 
 mod reader;
-use reader::{Reader, Input};
+mod serve;
+use reader::{Reader, Token};
+
+pub mod file;
+pub mod event;
+pub mod cache;
 
 #[no_mangle]
-pub extern fn create_reader(argc: usize, argv: *const *const c_char) -> *mut Reader {
+pub extern "C" fn create_reader(argc: usize, argv: *const *const c_char) -> *mut Reader {
     let args = unsafe { slice::from_raw_parts(argv, argc) };
     let args: Vec<String> = args.iter().map(|arg| {
         unsafe { CStr::from_ptr(*arg) }.to_str().unwrap().to_owned()
@@ -23,6 +35,11 @@ pub extern fn create_reader(argc: usize, argv: *const *const c_char) -> *mut Rea
         .arg(Arg::with_name("FILE")
             .help("Source file")
             .index(1))
+        .arg(Arg::with_name("serve")
+            .long("serve")
+            .value_name("SOCKET")
+            .help("Loads FILE, then runs each script sent to the Unix socket SOCKET in a fork")
+            .takes_value(true))
         .get_matches_from(args);
 
     let mut _reader = Reader::new();
@@ -30,36 +47,199 @@ pub extern fn create_reader(argc: usize, argv: *const *const c_char) -> *mut Rea
     if file.is_some() {
         _reader.read_file(file.unwrap())
     }
+    if let Some(socket) = matches.value_of("serve") {
+        _reader.serve(socket);
+    }
     let _reader = unsafe { transmute(Box::new(_reader)) };
     return _reader;
 }
 
 #[no_mangle]
-pub extern fn read_word_from_reader(ptr: *mut Reader, inbuf_ptr: *mut c_char, max_len: i64) -> i64 {
+pub extern "C" fn create_buffer_reader() -> *mut Reader {
+    unsafe { transmute(Box::new(Reader::empty())) }
+}
+
+/// Makes the reader read `len` bytes at `ptr` before resuming its current input.
+#[no_mangle]
+pub extern "C" fn reader_evaluate(ptr: *mut Reader, text: *const c_char, len: i64) {
+    let _reader = unsafe { &mut *ptr };
+    _reader.evaluate(unsafe { slice::from_raw_parts(text as *const u8, len as usize) });
+}
+
+#[no_mangle]
+pub extern "C" fn reader_reset(ptr: *mut Reader) {
+    let _reader = unsafe { &mut *ptr };
+    _reader.reset();
+}
+
+#[no_mangle]
+pub extern "C" fn read_word_from_reader(ptr: *mut Reader, inbuf_ptr: *mut c_char, max_len: i64) -> i64 {
     let mut _reader = unsafe { &mut *ptr };
     let inbuf = unsafe { slice::from_raw_parts_mut(inbuf_ptr, max_len as usize) };
-    let input = _reader.read();
-    match input {
-        Input::Word(word) | Input::Quote(word) => {
-            let len = word.len();
-            let c_word = CString::new(word).unwrap();
-            let c_word_bytes = c_word.as_bytes_with_nul();
-            let c_word_bytes = unsafe { &*(c_word_bytes as *const [u8] as *const [i8]) };
-            inbuf[..=len].clone_from_slice(c_word_bytes);
+    match _reader.next_token() {
+        Token::Word(word) | Token::Quote(word) => {
+            let bytes = word.as_bytes();
+            let len = bytes.len().min(inbuf.len() - 1);
+            for (dst, src) in inbuf.iter_mut().zip(&bytes[..len]) {
+                *dst = *src as c_char;
+            }
+            inbuf[len] = 0;
             return len as i64;
         },
-        Input::Interrupted | Input::Eof => {
+        Token::Interrupted | Token::Eof => {
             inbuf[0] = -1;
             return 0;
         },
-        Input::Newline => {
+        Token::Newline => {
             inbuf[0] = 10;
             return 0;
         }
     }
 }
 
+/// Parses a floating point literal. Like other Forths, a literal needs a '.' or an
+/// exponent to be a float, so plain integers are left to `number`.
+#[no_mangle]
+pub extern "C" fn string_to_float(ptr: *const c_char, len: i64, ok: *mut i64) -> f64 {
+    let bytes = unsafe { slice::from_raw_parts(ptr as *const u8, len as usize) };
+    let is_float = bytes.iter().any(|&c| c == b'.' || c == b'e' || c == b'E');
+    let parsed = match str::from_utf8(bytes) {
+        Ok(s) if s.ends_with('e') || s.ends_with('E') => format!("{}0", s).parse::<f64>().ok(),
+        Ok(s) => s.parse::<f64>().ok(),
+        Err(_) => None,
+    };
+    match parsed {
+        Some(value) if is_float => {
+            unsafe { *ok = -1 };
+            value
+        },
+        _ => {
+            unsafe { *ok = 0 };
+            0.0
+        },
+    }
+}
+
+/// Microseconds from an arbitrary but fixed point, for timing code.
+#[no_mangle]
+pub extern "C" fn get_utime() -> i64 {
+    let mut time = libc::timespec { tv_sec: 0, tv_nsec: 0 };
+    unsafe { libc::clock_gettime(libc::CLOCK_MONOTONIC, &mut time) };
+    time.tv_sec as i64 * 1_000_000 + time.tv_nsec as i64 / 1_000
+}
+
+/// Appends `len` bytes at `text` to the line `buf` of `size` bytes, which holds `*used`, and
+/// cuts what does not fit. Like dump_append_int it only copies, without stdio or allocation,
+/// because the trace and stats dumps build their lines with it in signal handlers.
+#[no_mangle]
+pub extern "C" fn dump_append(buf: *mut u8, size: i64, used: *mut i64, text: *const u8, len: i64) {
+    unsafe {
+        let at = *used;
+        let n = len.min(size - at).max(0);
+        ptr::copy_nonoverlapping(text, buf.offset(at as isize), n as usize);
+        *used = at + n;
+    }
+}
+
+/// Appends the decimal digits of `value` to the line `buf`, see dump_append.
+#[no_mangle]
+pub extern "C" fn dump_append_int(buf: *mut u8, size: i64, used: *mut i64, value: i64) {
+    let mut digits = [0u8; 20];
+    let mut i = digits.len();
+    let mut rest = if value < 0 { (value as u64).wrapping_neg() } else { value as u64 };
+    loop {
+        i -= 1;
+        digits[i] = b'0' + (rest % 10) as u8;
+        rest /= 10;
+        if rest == 0 {
+            break;
+        }
+    }
+    if value < 0 {
+        dump_append(buf, size, used, b"-".as_ptr(), 1);
+    }
+    dump_append(buf, size, used, digits[i..].as_ptr(), (digits.len() - i) as i64);
+}
+
+// The dump functions of the signal handlers, as addresses which a handler can read safely, or 0
+static TRACE_DUMP: AtomicUsize = AtomicUsize::new(0);
+static STATS_DUMP: AtomicUsize = AtomicUsize::new(0);
+
+fn call_dump(dump: &AtomicUsize) {
+    let dump = dump.load(Ordering::SeqCst);
+    if dump != 0 {
+        let dump: extern "C" fn() = unsafe { transmute(dump) };
+        dump();
+    }
+}
+
+extern "C" fn dump_trace_on_signal(signal: libc::c_int) {
+    call_dump(&TRACE_DUMP);
+    unsafe {
+        libc::signal(signal, libc::SIG_DFL);
+        libc::raise(signal);
+    }
+}
+
+/// Dumps the execution trace when the interpreter dies from a fatal signal, then dies
+/// from the same signal so the exit status is kept.
+#[no_mangle]
+pub extern "C" fn install_trace_handler(dump: extern "C" fn()) {
+    TRACE_DUMP.store(dump as usize, Ordering::SeqCst);
+    unsafe {
+        for &signal in &[libc::SIGSEGV, libc::SIGBUS, libc::SIGFPE, libc::SIGILL, libc::SIGABRT] {
+            libc::signal(signal, dump_trace_on_signal as libc::sighandler_t);
+        }
+    }
+}
+
+extern "C" fn dump_stats_on_signal(_signal: libc::c_int) {
+    call_dump(&STATS_DUMP);
+}
+
+/// Dumps the statistics on SIGUSR1 without stopping the interpreter. Returns -1 when
+/// LLFORTH_STATS is set, so bye dumps them as well, 0 otherwise.
+#[no_mangle]
+pub extern "C" fn install_stats_handler(dump: extern "C" fn()) -> i64 {
+    STATS_DUMP.store(dump as usize, Ordering::SeqCst);
+    unsafe {
+        libc::signal(libc::SIGUSR1, dump_stats_on_signal as libc::sighandler_t);
+    }
+    if env::var_os("LLFORTH_STATS").is_some() { -1 } else { 0 }
+}
+
+/// The dispatch budget of an interpreter compiled with --budget: $LLFORTH_BUDGET, or 0 for none
+/// when it is unset or empty. Exits when it is not a number rather than run without a limit.
+#[no_mangle]
+pub extern "C" fn budget_from_env() -> i64 {
+    let budget = match env::var_os("LLFORTH_BUDGET") {
+        Some(budget) => budget,
+        None => return 0,
+    };
+    if budget.is_empty() {
+        return 0;
+    }
+    match budget.to_str().and_then(|budget| budget.parse().ok()) {
+        Some(budget) => budget,
+        None => {
+            eprintln!("llforth: LLFORTH_BUDGET is not a number: {:?}", budget);
+            process::exit(2);
+        },
+    }
+}
+
+/// Creates the file a profiling interpreter writes its counts to, $LLFORTH_PROFILE or
+/// llforth.profile, and returns its descriptor, or -1.
+#[no_mangle]
+pub extern "C" fn profile_open() -> i64 {
+    let path = env::var_os("LLFORTH_PROFILE").unwrap_or_else(|| "llforth.profile".into());
+    match File::create(path) {
+        Ok(file) => file.into_raw_fd() as i64,
+        Err(_) => -1,
+    }
+}
+
 #[no_mangle]
-pub extern fn destroy_reader(ptr: *mut Reader) {
+pub extern "C" fn destroy_reader(ptr: *mut Reader) {
     let _reader: Box<Reader> = unsafe { transmute(ptr) };
 }
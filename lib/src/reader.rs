@@ -1,113 +1,211 @@
-use std::collections::VecDeque;
 use std::fs::File;
-use std::io::{BufRead, BufReader};
+use std::io;
+use std::io::{BufRead, BufReader, Cursor};
 
 use rustyline::error::ReadlineError;
 use rustyline::{Editor, Config};
 use atty::Stream;
 
-pub enum Input {
-    Word(String),
-    Quote(String),
+use serve;
+
+const STREAM_BUFFER_SIZE: usize = 64 * 1024;
+
+/// A token borrowing the current line, so the FFI can copy it without allocating.
+pub enum Token<'a> {
+    Word(&'a str),
+    Quote(&'a str),
+    Newline,
+    Eof,
+    Interrupted,
+}
+
+enum Source {
+    Editor(Editor<()>),
+    Stream(Box<dyn BufRead>),
+}
+
+// Where the tokenizer is within `line`
+#[derive(Clone, Copy)]
+enum State {
+    Empty,
+    Word(usize),
+    Quote(usize),
     Newline,
     Eof,
+    // The end of an evaluated buffer, after which the saved input resumes
+    Restore,
     Interrupted,
 }
 
 pub struct Reader {
-    buffer: VecDeque<Input>,
-    editor: Editor<()>,
+    source: Source,
+    line: String,
+    state: State,
+    saved: Vec<(Source, String, State)>,
+    // Socket to serve once the current input ends
+    serve: Option<String>,
 }
 
 impl Reader {
     pub fn new() -> Reader {
-        let buffer = VecDeque::new();
-        let editor = Editor::<()>::with_config(Config::builder()
-            .build());
-        Reader { buffer, editor }
+        let source = if atty::is(Stream::Stdin) {
+            Source::Editor(Editor::<()>::with_config(Config::builder().build()))
+        } else {
+            Source::Stream(Box::new(BufReader::with_capacity(STREAM_BUFFER_SIZE, io::stdin())))
+        };
+        Reader { source, line: String::new(), state: State::Empty, saved: Vec::new(), serve: None }
     }
 
-    pub fn read(&mut self) -> Input {
-        if self.buffer.is_empty() {
-            self.read_line()
-        }
-        match self.buffer.pop_front() {
-            Some(input) => return input,
-            None => return self.read(),
+    /// A reader without input of its own, for a VM embedded in another program.
+    pub fn empty() -> Reader {
+        Reader { source: Source::Stream(Box::new(io::empty())), line: String::new(), state: State::Empty, saved: Vec::new(), serve: None }
+    }
+
+    /// Serves `path` once the current input, e.g. a library file, has been read. Every
+    /// connection continues in a fork of the interpreter, reading the connection.
+    pub fn serve(&mut self, path: &str) {
+        self.serve = Some(path.to_owned());
+    }
+
+    /// Reads from a copy of `text` until its end, which is reported as Eof once before
+    /// the current input resumes.
+    pub fn evaluate(&mut self, text: &[u8]) {
+        let source = Source::Stream(Box::new(Cursor::new(text.to_vec())));
+        let line = String::new();
+        self.saved.push((
+            ::std::mem::replace(&mut self.source, source),
+            ::std::mem::replace(&mut self.line, line),
+            self.state,
+        ));
+        self.state = State::Empty;
+    }
+
+    /// How many inputs are saved below the current one by `evaluate`.
+    pub fn depth(&self) -> usize {
+        self.saved.len()
+    }
+
+    /// Drops evaluated buffers left unfinished, e.g. by a throw.
+    pub fn reset(&mut self) {
+        if !self.saved.is_empty() {
+            let (source, line, state) = self.saved.swap_remove(0);
+            self.source = source;
+            self.line = line;
+            self.state = state;
+            self.saved.clear();
         }
     }
 
     pub fn read_file(&mut self, file: &str) {
         let file = File::open(file).expect("Can't open file");
-        let file = BufReader::new(file);
-        for line in file.lines() {
-            match line {
-                Ok(line) => {
-                    self.process_line(line.trim());
-                    self.buffer.push_back(Input::Newline);
+        self.source = Source::Stream(Box::new(BufReader::with_capacity(STREAM_BUFFER_SIZE, file)));
+        self.state = State::Empty;
+    }
+
+    pub fn next_token(&mut self) -> Token {
+        loop {
+            match self.state {
+                State::Empty => self.read_line(),
+                State::Newline => {
+                    self.state = State::Empty;
+                    return Token::Newline;
+                },
+                State::Eof => return Token::Eof,
+                State::Restore => {
+                    let (source, line, state) = self.saved.pop().unwrap();
+                    self.source = source;
+                    self.line = line;
+                    self.state = state;
+                    return Token::Eof;
+                },
+                State::Interrupted => {
+                    self.state = State::Empty;
+                    return Token::Interrupted;
+                },
+                State::Word(pos) => {
+                    let start = pos + self.line[pos..].len() - self.line[pos..].trim_start().len();
+                    if start == self.line.len() {
+                        self.state = State::Newline;
+                        continue;
+                    }
+                    let end = match self.line[start..].find(char::is_whitespace) {
+                        Some(index) => start + index,
+                        None => self.line.len(),
+                    };
+                    let word = &self.line[start..end];
+                    if word == "\\" {
+                        self.state = State::Newline;
+                        continue;
+                    }
+                    self.state = if end == self.line.len() {
+                        State::Newline
+                    } else if word == ".\"" || word == "s\"" {
+                        State::Quote(end)
+                    } else {
+                        State::Word(end)
+                    };
+                    return Token::Word(&self.line[start..end]);
+                },
+                State::Quote(pos) => {
+                    // The quote starts after the single space following ." or s"
+                    return match self.line[pos..].find('"') {
+                        Some(index) => {
+                            self.state = State::Word(pos + index + 1);
+                            Token::Quote(&self.line[pos + 1..pos + index])
+                        },
+                        None => {
+                            self.state = State::Newline;
+                            Token::Quote(&self.line[pos..])
+                        },
+                    };
                 },
-                Err(e) => panic!(e)
             }
         }
-        self.buffer.push_back(Input::Eof);
     }
 
     fn read_line(&mut self) {
-        let readline = self.editor.readline("> ");
-        match readline {
-            Ok(line) => {
-                let line = line.trim();
-                if ! atty::is(Stream::Stdin) {
-                    print!("{}", line);
-                }
-                if line != "" {
-                    self.editor.add_history_entry(line.as_ref());
-                    self.process_line(line);
-                }
-                self.buffer.push_back(Input::Newline);
-            },
-            Err(ReadlineError::Eof) => {
-                self.buffer.push_back(Input::Eof);
+        self.line.clear();
+        let result = match self.source {
+            Source::Editor(ref mut editor) => match editor.readline("> ") {
+                Ok(line) => {
+                    let line = line.trim();
+                    if line != "" {
+                        editor.add_history_entry(line.as_ref());
+                    }
+                    self.line.push_str(line);
+                    Ok(true)
+                },
+                Err(ReadlineError::Eof) => Ok(false),
+                Err(ReadlineError::Interrupted) => {
+                    self.state = State::Interrupted;
+                    return;
+                },
+                Err(err) => Err(err.to_string()),
             },
-            Err(ReadlineError::Interrupted) => {
-                self.buffer.push_back(Input::Interrupted);
+            Source::Stream(ref mut stream) => match stream.read_line(&mut self.line) {
+                Ok(0) => Ok(false),
+                Ok(_) => Ok(true),
+                Err(err) => Err(err.to_string()),
             },
-            Err(err) => {
-                panic!(err);
+        };
+        match result {
+            Ok(true) => {
+                let end = self.line.trim_end().len();
+                self.line.truncate(end);
+                self.state = State::Word(0);
             },
-        }
-    }
-
-    fn process_line(&mut self, line: &str) {
-        let whitespace = line.find(char::is_whitespace);
-        match whitespace {
-            Some(index) => {
-                let (word, next) = line.split_at(index);
-                if word == "\\" {
-                    return;
-                } else if word == ".\"" {
-                    self.buffer.push_back(Input::Word(String::from(word)));
-                    let double_quote = next.find("\"");
-                    match double_quote {
-                        Some(index) => {
-                            let (string, rest) = next.split_at(index);
-                            self.buffer.push_back(Input::Quote(String::from(&string[1..])));
-                            self.process_line(&rest[1..]);
-                        },
-                        None => {
-                            self.buffer.push_back(Input::Quote(String::from(next)));
-                            return;
-                        },
+            Ok(false) if !self.saved.is_empty() => self.state = State::Restore,
+            Ok(false) => match self.serve.take() {
+                Some(path) => {
+                    if let Err(err) = serve::serve(&path) {
+                        panic!("{}: {}", path, err);
                     }
-                } else {
-                    self.buffer.push_back(Input::Word(String::from(word)));
-                    self.process_line(next.trim_left());
-                }
-            },
-            None => {
-                self.buffer.push_back(Input::Word(String::from(line)));
-                return;
+                    self.source = Source::Stream(Box::new(BufReader::with_capacity(STREAM_BUFFER_SIZE, io::stdin())));
+                    self.read_line();
+                },
+                None => self.state = State::Eof,
             },
+            Err(err) => panic!("{}", err),
         }
     }
 }
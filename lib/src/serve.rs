@@ -0,0 +1,77 @@
+use std::io;
+use std::io::Write;
+use std::os::unix::io::IntoRawFd;
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::ptr;
+
+use libc;
+use libc::c_int;
+
+/// The exit status reported to the client: the code of the worker, or 128 + the signal
+/// which killed it, like a shell.
+fn exit_status(status: c_int) -> i32 {
+    if libc::WIFSIGNALED(status) { 128 + libc::WTERMSIG(status) } else { libc::WEXITSTATUS(status) }
+}
+
+fn wait(pid: libc::pid_t) -> i32 {
+    let mut status: c_int = 0;
+    loop {
+        if unsafe { libc::waitpid(pid, &mut status, 0) } >= 0 {
+            return exit_status(status);
+        }
+        if io::Error::last_os_error().kind() != io::ErrorKind::Interrupted {
+            return -1;
+        }
+    }
+}
+
+/// Runs in a child per connection. Forks the worker, which returns with its stdin and
+/// stdout bound to the connection, then sends the worker's exit status as a big-endian
+/// i32 after everything it wrote.
+fn supervise(mut stream: UnixStream) -> io::Result<()> {
+    unsafe { libc::signal(libc::SIGCHLD, libc::SIG_DFL) };
+    let code = match unsafe { libc::fork() } {
+        0 => {
+            let fd = stream.into_raw_fd();
+            unsafe {
+                libc::dup2(fd, 0);
+                libc::dup2(fd, 1);
+                libc::close(fd);
+            }
+            return Ok(());
+        },
+        pid if pid < 0 => -1,
+        pid => wait(pid),
+    };
+    let bytes = [(code >> 24) as u8, (code >> 16) as u8, (code >> 8) as u8, code as u8];
+    let _ = stream.write_all(&bytes);
+    unsafe { libc::_exit(0) };
+}
+
+/// Serves `path` until the process is killed. Each connection is handled by a fork of
+/// the already loaded interpreter, so this returns only in such a fork, reading the
+/// script from the connection.
+pub fn serve(path: &str) -> io::Result<()> {
+    let listener = UnixListener::bind(path)?;
+    unsafe {
+        // Output buffered while loading would be written again by every fork
+        libc::fflush(ptr::null_mut());
+        // Supervisors exit by themselves and need no reaping
+        libc::signal(libc::SIGCHLD, libc::SIG_IGN);
+    }
+    loop {
+        let (stream, _) = match listener.accept() {
+            Ok(connection) => connection,
+            Err(ref err) if err.kind() == io::ErrorKind::Interrupted => continue,
+            Err(err) => return Err(err),
+        };
+        match unsafe { libc::fork() } {
+            0 => {
+                drop(listener);
+                return supervise(stream);
+            },
+            pid if pid < 0 => return Err(io::Error::last_os_error()),
+            _ => drop(stream),
+        }
+    }
+}
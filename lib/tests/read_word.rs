@@ -20,35 +20,40 @@ fn example_0() {
 
 #[test]
 fn example_1() {
-    run("foo", "foo [(\"foo\", 3)]\n");
+    run("foo", " [(\"foo\", 3)]\n");
 }
 
 #[test]
 fn example_2() {
-    run("foo bar", "foo bar [(\"foo\", 3), (\"bar\", 3)]\n");
+    run("foo bar", " [(\"foo\", 3), (\"bar\", 3)]\n");
 }
 
 #[test]
 fn example_empty() {
-    run("foo  bar", "foo  bar [(\"foo\", 3), (\"bar\", 3)]\n");
+    run("foo  bar", " [(\"foo\", 3), (\"bar\", 3)]\n");
 }
 
 #[test]
 fn example_enter() {
-    run("\nfoo", " []\nfoo [(\"foo\", 3)]\n");
+    run("\nfoo", " []\n [(\"foo\", 3)]\n");
 }
 
 #[test]
 fn example_comment() {
-    run("foo \\ bar", "foo \\ bar [(\"foo\", 3)]\n");
+    run("foo \\ bar", " [(\"foo\", 3)]\n");
 }
 
 #[test]
 fn example_double_quote() {
-    run("foo .\" bar\"baz", "foo .\" bar\"baz [(\"foo\", 3), (\".\\\"\", 2), (\"bar\", 3), (\"baz\", 3)]\n");
+    run("foo .\" bar\"baz", " [(\"foo\", 3), (\".\\\"\", 2), (\"bar\", 3), (\"baz\", 3)]\n");
 }
 
 #[test]
 fn example_double_quote_endline() {
-    run("foo .\" bar", "foo .\" bar [(\"foo\", 3), (\".\\\"\", 2), (\" bar\", 4)]\n");
+    run("foo .\" bar", " [(\"foo\", 3), (\".\\\"\", 2), (\" bar\", 4)]\n");
+}
+
+#[test]
+fn example_s_quote() {
+    run("s\" foo bar\" baz", " [(\"s\\\"\", 2), (\"foo bar\", 7), (\"baz\", 3)]\n");
 }
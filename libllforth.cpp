@@ -0,0 +1,80 @@
+#include "llforth.h"
+
+// From the Rust library
+extern "C" {
+    void* create_buffer_reader();
+    void reader_reset(void*);
+    void destroy_reader(void*);
+}
+
+// From the interpreter compiled by llforthc --embed
+extern "C" {
+    int64_t llforth_enter(void*, const void*);
+    void llforth_stack_push(int64_t);
+    int64_t llforth_stack_pop();
+    int64_t llforth_stack_depth();
+    const void* find_xt(const char*, int64_t);
+    void llforth_set_budget(int64_t);
+}
+
+struct llforth_vm {
+    void* reader;
+    const void* evaluate;
+    bool stopped;
+};
+
+static bool Created = false;
+
+llforth_vm* llforth_create() {
+    if (Created) { return nullptr; }
+    auto evaluate = find_xt("evaluate", 8);
+    if (!evaluate) { return nullptr; }
+    Created = true;
+    return new llforth_vm{create_buffer_reader(), evaluate, false};
+}
+
+void llforth_destroy(llforth_vm* vm) {
+    destroy_reader(vm->reader);
+    delete vm;
+    Created = false;
+}
+
+int64_t llforth_eval(llforth_vm* vm, const char* source, size_t length) {
+    // Input left over by a throw in a previous eval
+    reader_reset(vm->reader);
+    llforth_stack_push((int64_t)source);
+    llforth_stack_push((int64_t)length);
+    return llforth_call(vm, vm->evaluate);
+}
+
+void llforth_push(llforth_vm* vm, int64_t cell) {
+    llforth_stack_push(cell);
+}
+
+int64_t llforth_pop(llforth_vm* vm) {
+    return llforth_stack_pop();
+}
+
+int64_t llforth_depth(llforth_vm* vm) {
+    return llforth_stack_depth();
+}
+
+const void* llforth_find(llforth_vm* vm, const char* name, size_t length) {
+    return find_xt(name, (int64_t)length);
+}
+
+int64_t llforth_call(llforth_vm* vm, const void* xt) {
+    auto code = llforth_enter(vm->reader, xt);
+    vm->stopped = code == LLFORTH_BUDGET_EXHAUSTED;
+    return code;
+}
+
+void llforth_budget(llforth_vm* vm, int64_t budget) {
+    llforth_set_budget(budget);
+}
+
+int64_t llforth_resume(llforth_vm* vm) {
+    if (!vm->stopped) { return 0; }
+    // A null xt makes llforth_enter continue from where the budget ran out
+    return llforth_call(vm, nullptr);
+}
@@ -0,0 +1,43 @@
+#ifndef LLFORTH_H
+#define LLFORTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The VM state lives in the globals of the embedded interpreter, so a process has at most one VM. */
+typedef struct llforth_vm llforth_vm;
+
+/* Returns NULL when a VM already exists. */
+llforth_vm* llforth_create(void);
+void llforth_destroy(llforth_vm* vm);
+
+/* Interprets a source buffer like the llforth REPL. Returns 0, or the code of an uncaught throw. */
+int64_t llforth_eval(llforth_vm* vm, const char* source, size_t length);
+
+void llforth_push(llforth_vm* vm, int64_t cell);
+int64_t llforth_pop(llforth_vm* vm);
+int64_t llforth_depth(llforth_vm* vm);
+
+/* Returns the xt of a word, or NULL when it is not defined. */
+const void* llforth_find(llforth_vm* vm, const char* name, size_t length);
+/* Runs an xt on the data stack. Returns like llforth_eval. */
+int64_t llforth_call(llforth_vm* vm, const void* xt);
+
+/* Returned when the dispatch budget of an interpreter compiled with llforthc --budget runs out. */
+#define LLFORTH_BUDGET_EXHAUSTED (-257)
+
+/* Sets how many backward branches and colon calls may run before LLFORTH_BUDGET_EXHAUSTED, 0 for no limit.
+   Once it ran out, every call returns LLFORTH_BUDGET_EXHAUSTED again until a new budget is set. */
+void llforth_budget(llforth_vm* vm, int64_t budget);
+/* Continues the eval or call stopped by LLFORTH_BUDGET_EXHAUSTED, or returns 0 when there is none. */
+int64_t llforth_resume(llforth_vm* vm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LLFORTH_H
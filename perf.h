@@ -0,0 +1,45 @@
+#ifndef LLFORTH_PERF_H
+#define LLFORTH_PERF_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+
+// Symbols for `llforthc --perf-symbols`. Every native word block starts with a local
+// label `forth.<name>.<n>`, so perf and other profilers reading the ELF symbol table
+// attribute samples inside main to the primitive which was running.
+namespace perf {
+    static bool Enabled = false;
+
+    // Quoted assembler symbols accept anything except these
+    static std::string GetSymbolName(const std::string& name) {
+        std::string symbol = "forth." + name;
+        for (auto& c : symbol) {
+            if (c == '"' || c == '\\' || c == '$') { c = '_'; }
+        }
+        return symbol;
+    }
+
+    // ${:uid} keeps labels unique when llc duplicates a block
+    static void CreateLabel(BasicBlock* block, const std::string& name) {
+        core::Builder.SetInsertPoint(block, block->getFirstInsertionPt());
+        auto label = "\"" + GetSymbolName(name) + ".${:uid}\":";
+        auto type = FunctionType::get(core::VoidType, false);
+        core::Builder.CreateCall(InlineAsm::get(type, label, "", true));
+    }
+
+    static void Finalize() {
+        auto insert_block = core::Builder.GetInsertBlock();
+        CreateLabel(engine::Next, "next");
+        for (const auto& word : dict::Dictionary) {
+            if (word.second.block) { CreateLabel(word.second.block, word.first); }
+        }
+        core::Builder.SetInsertPoint(insert_block);
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        if (Enabled) { engine::Finalizers.push_back(Finalize); }
+    }
+}
+
+#endif //LLFORTH_PERF_H
@@ -0,0 +1,282 @@
+#ifndef LLFORTH_PROFILE_H
+#define LLFORTH_PROFILE_H
+
+#include <llvm/IR/MDBuilder.h>
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "kernel.h"
+
+// Profile guided layout. `llforthc --profile-generate` counts the dispatches of every word,
+// the transitions between consecutive words and the outcomes of 0branch, and bye writes them
+// to $LLFORTH_PROFILE (llforth.profile by default). `llforthc --profile-use FILE` compiles the
+// same source with the hottest colon bodies first on dict_memory and the hottest primitives
+// right after next, weights the indirectbr and 0branch, and lists the hottest transitions
+// between primitives as superinstruction candidates. Words are matched by index and name.
+// Without --profile-generate neither the counters nor profile_write exist.
+namespace profile {
+    const static uint64_t TransitionSize = 4096; // Must be a power of two
+    const static size_t Candidates = 10;
+    static bool Generate = false;
+    static std::string UsePath;
+
+    static Constant* Counts;
+    static Constant* Transitions;
+    static Constant* Last;
+    static Constant* Taken;
+    static Constant* NotTaken;
+    // Set by 0branch, whose only conditional branch gets the weights
+    static BranchInst* Branch0;
+
+    static StructType* CreateTransitionType() {
+        auto transition_type = StructType::create(core::TheContext, "profile_transition");
+        transition_type->setBody({
+            core::IntType,  // Index of the previous xt
+            core::IntType,  // Index of the dispatched xt
+            core::IntType,  // Count, 0 for a free slot
+        });
+        return transition_type;
+    };
+    const static auto TransitionType = CreateTransitionType();
+    enum TransitionMember {
+        TransitionFrom, TransitionTo, TransitionCount,
+    };
+
+    const static core::Func WriteFunc {
+        "profile_write", FunctionType::get(core::VoidType, {}, false)
+    };
+    const static core::Func OpenFunc {
+        "profile_open", FunctionType::get(core::IntType, {}, false)
+    };
+
+    struct Transition {
+        uint64_t from;
+        uint64_t to;
+        uint64_t count;
+    };
+    static std::map<uint64_t, std::pair<std::string, uint64_t>> UseCounts = {};
+    static std::vector<Transition> UseTransitions = {};
+    static uint64_t UseTaken = 0;
+    static uint64_t UseNotTaken = 0;
+
+    static Value* GetTransitionMember(Value* slot, TransitionMember member) {
+        return core::Builder.CreateGEP(Transitions, {core::GetInt(0), slot, core::GetIndex(member)});
+    }
+
+    static void Add(Value* counter, Value* value) {
+        core::Builder.CreateStore(core::Builder.CreateAdd(core::Builder.CreateLoad(counter), value), counter);
+    }
+
+    // A transition whose slot is taken by another pair is dropped, so the table never needs probing
+    static void Record() {
+        auto index = dict::GetXtIndex(dict::GetXt());
+        Add(core::Builder.CreateGEP(Counts, {core::GetInt(0), index}), core::GetInt(1));
+        auto last = core::Builder.CreateLoad(Last);
+        auto hash = core::Builder.CreateAdd(core::Builder.CreateMul(last, core::GetInt(31)), index);
+        auto slot = core::Builder.CreateAnd(hash, core::GetInt(TransitionSize - 1));
+        auto from = GetTransitionMember(slot, TransitionFrom);
+        auto to = GetTransitionMember(slot, TransitionTo);
+        auto count = GetTransitionMember(slot, TransitionCount);
+        auto is_same = core::Builder.CreateAnd(
+                core::Builder.CreateICmpEQ(core::Builder.CreateLoad(from), last),
+                core::Builder.CreateICmpEQ(core::Builder.CreateLoad(to), index));
+        auto is_free = core::Builder.CreateICmpEQ(core::Builder.CreateLoad(count), core::GetInt(0));
+        auto is_hit = core::Builder.CreateOr(is_same, is_free);
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_hit, last, core::Builder.CreateLoad(from)), from);
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_hit, index, core::Builder.CreateLoad(to)), to);
+        Add(count, core::Builder.CreateZExt(is_hit, core::IntType));
+        core::Builder.CreateStore(index, Last);
+    }
+
+    // Called by 0branch with whether it branches
+    static void RecordBranch(Value* is_zero) {
+        Add(Taken, core::Builder.CreateZExt(is_zero, core::IntType));
+        Add(NotTaken, core::Builder.CreateZExt(core::Builder.CreateNot(is_zero), core::IntType));
+    }
+
+    static void Read() {
+        std::ifstream file(UsePath);
+        if (!file) {
+            std::cerr << "llforthc: cannot read profile " << UsePath << std::endl;
+            exit(1);
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "word") {
+                uint64_t index, count;
+                std::string name;
+                fields >> index >> name >> count;
+                UseCounts[index] = {name, count};
+            } else if (kind == "next") {
+                Transition transition{};
+                fields >> transition.from >> transition.to >> transition.count;
+                UseTransitions.push_back(transition);
+            } else if (kind == "branch") {
+                fields >> UseTaken >> UseNotTaken;
+            }
+        }
+    }
+
+    static std::string GetName(uint64_t index) {
+        auto str = dict::InitialHeaders[index]->getAggregateElement(dict::XtWord);
+        auto global = dyn_cast<GlobalVariable>(str->stripPointerCasts());
+        if (!global) { return ""; }
+        return cast<ConstantDataArray>(global->getInitializer())->getAsCString().str();
+    }
+
+    // The profiled count of the word at index, 0 when the profile was made from other code
+    static uint64_t GetCount(uint64_t index) {
+        auto found = UseCounts.find(index);
+        if (found == UseCounts.end() || index >= dict::InitialXts.size()) { return 0; }
+        return found->second.first == GetName(index) ? found->second.second : 0;
+    }
+
+    static BasicBlock* GetBlock(uint64_t index) {
+        auto addr = dict::InitialXts[index]->getAggregateElement(dict::XtImplAddress);
+        auto block_addr = dyn_cast<BlockAddress>(addr);
+        return block_addr ? block_addr->getBasicBlock() : nullptr;
+    }
+
+    // Branch weights are 32 bits, so large counts are scaled down together
+    static std::vector<uint32_t> GetWeights(const std::vector<uint64_t>& counts) {
+        uint64_t max = 1;
+        for (auto count: counts) { max = std::max(max, count); }
+        auto scale = max / UINT32_MAX + 1;
+        std::vector<uint32_t> weights = {};
+        for (auto count: counts) { weights.push_back((uint32_t)(count / scale) + 1); }
+        return weights;
+    }
+
+    // Before dict::Finalize, while colon bodies can still move
+    static void Layout() {
+        if (UsePath.empty()) { return; }
+        Read();
+        std::vector<size_t> order = {};
+        for (size_t i = 0; i < dict::Bodies.size(); i++) { order.push_back(i); }
+        std::stable_sort(order.begin(), order.end(), [](size_t a, size_t b) {
+            return GetCount(dict::XtIndices.at(dict::Bodies[a].xt)) > GetCount(dict::XtIndices.at(dict::Bodies[b].xt));
+        });
+        dict::MoveBodies(order);
+    }
+
+    // After dict::Finalize, once the indirectbrs have their destinations
+    static void Finalize() {
+        std::map<BasicBlock*, uint64_t> block_counts = {};
+        std::vector<std::pair<uint64_t, BasicBlock*>> hot_blocks = {};
+        for (uint64_t index = 0; index < dict::InitialXts.size(); index++) {
+            auto block = GetBlock(index);
+            if (block) { block_counts[block] += GetCount(index); }
+        }
+        for (auto block: dict::NativeBlocks) {
+            if (block_counts[block] > 0) { hot_blocks.emplace_back(block_counts[block], block); }
+        }
+        std::stable_sort(hot_blocks.begin(), hot_blocks.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        auto previous = engine::Next;
+        for (const auto& hot: hot_blocks) {
+            hot.second->moveAfter(previous);
+            previous = hot.second;
+        }
+
+        MDBuilder builder(core::TheContext);
+        for (auto br: dict::IndirectBrs) {
+            std::vector<uint64_t> counts = {};
+            for (unsigned i = 0; i < br->getNumDestinations(); i++) { counts.push_back(block_counts[br->getDestination(i)]); }
+            br->setMetadata(LLVMContext::MD_prof, builder.createBranchWeights(GetWeights(counts)));
+        }
+        if (Branch0 && UseTaken + UseNotTaken > 0) {
+            Branch0->setMetadata(LLVMContext::MD_prof, builder.createBranchWeights(GetWeights({UseTaken, UseNotTaken})));
+        }
+
+        auto is_native = [](uint64_t index) {
+            return index < dict::InitialXts.size() && std::find(dict::NativeBlocks.begin(), dict::NativeBlocks.end(), GetBlock(index)) != dict::NativeBlocks.end();
+        };
+        std::vector<Transition> candidates = {};
+        for (const auto& transition: UseTransitions) {
+            if (is_native(transition.from) && is_native(transition.to) && GetCount(transition.from) > 0 && GetCount(transition.to) > 0) {
+                candidates.push_back(transition);
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.count > b.count; });
+        candidates.resize(std::min(candidates.size(), Candidates));
+        for (const auto& candidate: candidates) {
+            std::cerr << "superinstruction candidate: " << GetName(candidate.from) << " " << GetName(candidate.to)
+                      << " " << candidate.count << std::endl;
+        }
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        if (!UsePath.empty()) { engine::Finalizers.push_back(Finalize); }
+        if (!Generate) { return; }
+        Counts = core::CreateGlobalArrayVariable("profile_counts", core::IntType, dict::MaxWords, false);
+        auto transitions_type = ArrayType::get(TransitionType, TransitionSize);
+        Transitions = core::CreateGlobalVariable("profile_transitions", transitions_type, Constant::getNullValue(transitions_type), false);
+        // No word has this index, so the first dispatch is not a transition of any profiled word
+        Last = core::CreateGlobalVariable("profile_last", core::IntType, core::GetInt(dict::MaxWords), false);
+        Taken = core::CreateGlobalVariable("profile_taken", core::IntType, core::GetInt(0), false);
+        NotTaken = core::CreateGlobalVariable("profile_not_taken", core::IntType, core::GetInt(0), false);
+
+        core::Func dprintf = {
+                "dprintf", FunctionType::get(core::Builder.getInt32Ty(), {core::Builder.getInt32Ty(), core::StrType}, true)
+        };
+        core::Func close = {
+                "close", FunctionType::get(core::Builder.getInt32Ty(), {core::Builder.getInt32Ty()}, false)
+        };
+        core::CreateFunction(WriteFunc, [=](Function* f, BasicBlock*) {
+            auto opened = core::CreateBasicBlock("opened", f);
+            auto failed = core::CreateBasicBlock("failed", f);
+            auto open_fd = core::CallFunction(OpenFunc);
+            core::Builder.CreateCondBr(core::Builder.CreateICmpSLT(open_fd, core::GetInt(0)), failed, opened);
+            core::Builder.SetInsertPoint(failed);
+            core::Builder.CreateRetVoid();
+
+            core::Builder.SetInsertPoint(opened);
+            auto fd = core::Builder.CreateTrunc(open_fd, core::Builder.getInt32Ty());
+            auto word_fmt = core::Builder.CreateGlobalStringPtr("word %lld %.*s %lld\n");
+            auto words = core::Builder.CreateIntCast(core::Builder.CreateLoad(dict::WordCount), core::IntType, false);
+            kernel::CreateLoop(f, "words", core::GetInt(0), words, 1, {}, [=](Value* index, const kernel::Values&) -> kernel::Values {
+                auto write = core::CreateBasicBlock("write_word", f);
+                auto next = core::CreateBasicBlock("next_word", f);
+                auto count = core::Builder.CreateLoad(core::Builder.CreateGEP(Counts, {core::GetInt(0), index}));
+                core::Builder.CreateCondBr(core::Builder.CreateICmpEQ(count, core::GetInt(0)), next, write);
+                core::Builder.SetInsertPoint(write);
+                auto xt = core::Builder.CreateGEP(dict::Xts, {core::GetInt(0), index});
+                auto length = core::Builder.CreateIntCast(dict::GetXtWordLength(xt), core::Builder.getInt32Ty(), false);
+                core::CallFunction(dprintf, {fd, word_fmt, index, length, dict::GetXtWord(xt), count});
+                core::Builder.CreateBr(next);
+                core::Builder.SetInsertPoint(next);
+                return {};
+            });
+            auto next_fmt = core::Builder.CreateGlobalStringPtr("next %lld %lld %lld\n");
+            kernel::CreateLoop(f, "transitions", core::GetInt(0), core::GetInt(TransitionSize), 1, {}, [=](Value* slot, const kernel::Values&) -> kernel::Values {
+                auto write = core::CreateBasicBlock("write_transition", f);
+                auto next = core::CreateBasicBlock("next_transition", f);
+                auto count = core::Builder.CreateLoad(GetTransitionMember(slot, TransitionCount));
+                core::Builder.CreateCondBr(core::Builder.CreateICmpEQ(count, core::GetInt(0)), next, write);
+                core::Builder.SetInsertPoint(write);
+                core::CallFunction(dprintf, {
+                        fd, next_fmt,
+                        core::Builder.CreateLoad(GetTransitionMember(slot, TransitionFrom)),
+                        core::Builder.CreateLoad(GetTransitionMember(slot, TransitionTo)),
+                        count,
+                });
+                core::Builder.CreateBr(next);
+                core::Builder.SetInsertPoint(next);
+                return {};
+            });
+            core::CallFunction(dprintf, {
+                    fd, core::Builder.CreateGlobalStringPtr("branch %lld %lld\n"),
+                    core::Builder.CreateLoad(Taken), core::Builder.CreateLoad(NotTaken),
+            });
+            core::CallFunction(close, {fd});
+            core::Builder.CreateRetVoid();
+        });
+
+        core::Builder.SetInsertPoint(entry);
+        engine::NextHooks.push_back(Record);
+    }
+}
+
+#endif //LLFORTH_PROFILE_H
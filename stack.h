@@ -10,10 +10,17 @@
 #include "util.h"
 
 namespace stack {
+    // Each task owns a StackSize region of every stack, so the stack pointers stay plain indices
+    const static uint64_t StackSize = 1024;
+    const static uint64_t MaxTasks = 16;
+
+    static Constant* CurrentTask;
     static Value* SP;
     static Constant* Stack;
     static Value* RSP;
     static Constant* RStack;
+    static Value* FSP;
+    static Constant* FStack;
 
     static void Push(Value* value) {
         auto current_sp = core::Builder.CreateLoad(SP);
@@ -70,10 +77,15 @@ namespace stack {
         core::Builder.CreateStore(core::Builder.CreateAdd(current_sp, core::GetIndex(1)), SP);
     }
 
+    static Value* GetBase() {
+        return core::Builder.CreateMul(core::Builder.CreateLoad(CurrentTask), core::GetIndex(StackSize));
+    }
+
     static void Print() {
-        auto current_sp = core::Builder.CreateLoad(SP);
+        auto base = GetBase();
+        auto current_sp = core::Builder.CreateSub(core::Builder.CreateLoad(SP), base);
         auto top_sp = core::Builder.CreateSub(current_sp, core::GetIndex(1));
-        auto start_addr = core::Builder.CreateGEP(Stack, {core::GetIndex(0), core::GetIndex(0)});
+        auto start_addr = core::Builder.CreateGEP(Stack, {core::GetIndex(0), base});
         core::CallFunction(util::PrintStackFunc, {top_sp, start_addr});
     }
 
@@ -109,14 +121,55 @@ namespace stack {
         return core::Builder.CreateLoad(addr);
     }
 
+    static void FPush(Value* value) {
+        auto current_fsp = core::Builder.CreateLoad(FSP);
+        auto addr = core::Builder.CreateGEP(FStack, {core::GetIndex(0), current_fsp});
+        core::Builder.CreateStore(value, addr);
+        core::Builder.CreateStore(core::Builder.CreateAdd(current_fsp, core::GetIndex(1)), FSP);
+    }
+
+    static LoadInst* FPop() {
+        auto current_fsp = core::Builder.CreateLoad(FSP);
+        auto top_fsp = core::Builder.CreateSub(current_fsp, core::GetIndex(1));
+        auto addr = core::Builder.CreateGEP(FStack, {core::GetIndex(0), top_fsp});
+        core::Builder.CreateStore(top_fsp, FSP);
+        return core::Builder.CreateLoad(addr);
+    }
+
+    static void FDrop() {
+        auto current_fsp = core::Builder.CreateLoad(FSP);
+        auto top_fsp = core::Builder.CreateSub(current_fsp, core::GetIndex(1));
+        core::Builder.CreateStore(top_fsp, FSP);
+    }
+
+    static void FDup() {
+        auto current_fsp = core::Builder.CreateLoad(FSP);
+        auto current_addr = core::Builder.CreateGEP(FStack, {core::GetIndex(0), current_fsp});
+        auto top_fsp = core::Builder.CreateSub(current_fsp, core::GetIndex(1));
+        auto top_addr = core::Builder.CreateGEP(FStack, {core::GetIndex(0), top_fsp});
+        core::Builder.CreateStore(core::Builder.CreateLoad(top_addr), current_addr);
+        core::Builder.CreateStore(core::Builder.CreateAdd(current_fsp, core::GetIndex(1)), FSP);
+    }
+
     static void Initialize(Function* main, BasicBlock* entry) {
-        SP = core::Builder.CreateAlloca(core::IndexType, nullptr, "sp");
-        core::Builder.CreateStore(core::GetIndex(0), SP);
-        Stack = core::CreateGlobalArrayVariable("stack", core::IntType, 1024, false);
-        
-        RSP = core::Builder.CreateAlloca(core::IndexType, nullptr, "rsp");
-        core::Builder.CreateStore(core::GetIndex(0), RSP);
-        RStack = core::CreateGlobalArrayVariable("rstack", dict::XtPtrPtrType, 1024, false);
+        CurrentTask = core::CreateGlobalVariable("task_current", core::IndexType, core::GetIndex(0), false);
+
+        // An embedded VM keeps its stacks between calls, so the stack pointers can't be locals
+        if (engine::Embed) {
+            SP = core::CreateGlobalVariable("sp", core::IndexType, core::GetIndex(0), false);
+            RSP = core::CreateGlobalVariable("rsp", core::IndexType, core::GetIndex(0), false);
+            FSP = core::CreateGlobalVariable("fsp", core::IndexType, core::GetIndex(0), false);
+        } else {
+            SP = core::Builder.CreateAlloca(core::IndexType, nullptr, "sp");
+            core::Builder.CreateStore(core::GetIndex(0), SP);
+            RSP = core::Builder.CreateAlloca(core::IndexType, nullptr, "rsp");
+            core::Builder.CreateStore(core::GetIndex(0), RSP);
+            FSP = core::Builder.CreateAlloca(core::IndexType, nullptr, "fsp");
+            core::Builder.CreateStore(core::GetIndex(0), FSP);
+        }
+        Stack = core::CreateGlobalArrayVariable("stack", core::IntType, StackSize * MaxTasks, false);
+        RStack = core::CreateGlobalArrayVariable("rstack", dict::CodePtrType, StackSize * MaxTasks, false);
+        FStack = core::CreateGlobalArrayVariable("fstack", core::FloatType, StackSize * MaxTasks, false);
     }
 }
 
@@ -0,0 +1,138 @@
+#ifndef LLFORTH_STATS_H
+#define LLFORTH_STATS_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "stack.h"
+#include "util.h"
+
+// Memory and dispatch statistics for `llforthc --stats`. The next block counts dispatches
+// and keeps the high-water marks of the stacks and here, create counts the words and name
+// bytes it allocates, and word and interpret keep the longest token read into the input
+// buffer. `.stats` reports them against their limits; SIGUSR1, and bye when LLFORTH_STATS
+// is set, dump them as a single key=value line. Stack depths are sampled between words.
+// Without --stats none of this, `.stats` included, is compiled in.
+namespace stats {
+    const static uint64_t InputSize = 1024;
+    static bool Enabled = false;
+
+    static Constant* MaxSP;
+    static Constant* MaxRSP;
+    static Constant* MaxHere;
+    static Constant* MaxToken;
+    static Constant* Dispatches;
+    static Constant* WordsCreated;
+    static Constant* NameBytes;
+    static Constant* AtExit;
+
+    const static core::Func PrintFunc {
+        "stats_print", FunctionType::get(core::VoidType, {}, false)
+    };
+    const static core::Func DumpFunc {
+        "stats_dump", FunctionType::get(core::VoidType, {}, false)
+    };
+    const static core::Func ExitFunc {
+        "stats_exit", FunctionType::get(core::VoidType, {}, false)
+    };
+    const static core::Func InstallHandlerFunc {
+        "install_stats_handler", FunctionType::get(core::IntType, {DumpFunc.type->getPointerTo()}, false)
+    };
+
+    static void UpdateMax(Constant* max, Value* value) {
+        auto current = core::Builder.CreateLoad(max);
+        auto is_greater = core::Builder.CreateICmpSGT(value, current);
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_greater, value, current), max);
+    }
+
+    static void Add(Constant* counter, Value* value) {
+        core::Builder.CreateStore(core::Builder.CreateAdd(core::Builder.CreateLoad(counter), value), counter);
+    }
+
+    static Value* GetDepth(Value* pointer) {
+        auto depth = core::Builder.CreateSub(core::Builder.CreateLoad(pointer), stack::GetBase());
+        return core::Builder.CreateIntCast(depth, core::IntType, true);
+    }
+
+    static void Record() {
+        Add(Dispatches, core::GetInt(1));
+        UpdateMax(MaxSP, GetDepth(stack::SP));
+        UpdateMax(MaxRSP, GetDepth(stack::RSP));
+        UpdateMax(MaxHere, core::Builder.CreateIntCast(core::Builder.CreateLoad(dict::HereValue), core::IntType, true));
+    }
+
+    // Called by create with the length of the new word's name
+    static void RecordWord(Value* length) {
+        Add(WordsCreated, core::GetInt(1));
+        Add(NameBytes, length);
+    }
+
+    // Called by word and interpret with the length of the token they read
+    static void RecordToken(Value* length) {
+        UpdateMax(MaxToken, length);
+    }
+
+    // Every statistic followed by its limit, in the order of both report formats
+    static std::vector<Value*> GetValues() {
+        auto created = core::Builder.CreateLoad(WordsCreated);
+        auto word_size = ConstantExpr::getAdd(ConstantExpr::getSizeOf(dict::XtType), ConstantExpr::getSizeOf(dict::HeaderType));
+        return {
+                core::Builder.CreateLoad(MaxSP), core::GetInt(stack::StackSize),
+                core::Builder.CreateLoad(MaxRSP), core::GetInt(stack::StackSize),
+                core::Builder.CreateLoad(MaxHere), core::GetInt(dict::MemorySize),
+                core::Builder.CreateLoad(MaxToken), core::GetInt(InputSize),
+                core::Builder.CreateIntCast(core::Builder.CreateLoad(dict::WordCount), core::IntType, false), core::GetInt(dict::MaxWords),
+                created, core::Builder.CreateLoad(NameBytes), core::Builder.CreateMul(created, word_size),
+                core::Builder.CreateLoad(Dispatches),
+        };
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        if (!Enabled) { return; }
+        MaxSP = core::CreateGlobalVariable("stats_max_sp", core::IntType, core::GetInt(0), false);
+        MaxRSP = core::CreateGlobalVariable("stats_max_rsp", core::IntType, core::GetInt(0), false);
+        MaxHere = core::CreateGlobalVariable("stats_max_here", core::IntType, core::GetInt(0), false);
+        MaxToken = core::CreateGlobalVariable("stats_max_token", core::IntType, core::GetInt(0), false);
+        Dispatches = core::CreateGlobalVariable("stats_dispatches", core::IntType, core::GetInt(0), false);
+        WordsCreated = core::CreateGlobalVariable("stats_words_created", core::IntType, core::GetInt(0), false);
+        NameBytes = core::CreateGlobalVariable("stats_name_bytes", core::IntType, core::GetInt(0), false);
+        AtExit = core::CreateGlobalVariable("stats_at_exit", core::IntType, core::GetInt(0), false);
+
+        auto report = [=](const std::string& format) {
+            util::CreateWriteError(util::CreateErrorBuffer(), format, GetValues());
+            core::Builder.CreateRetVoid();
+        };
+        core::CreateFunction(PrintFunc, [=](Function* f, BasicBlock*) {
+            report("-- stats --\n"
+                   "stack      %lld/%lld cells\n"
+                   "rstack     %lld/%lld cells\n"
+                   "dict       %lld/%lld cells\n"
+                   "input      %lld/%lld bytes\n"
+                   "words      %lld/%lld\n"
+                   "created    %lld words, %lld name bytes, %lld header bytes\n"
+                   "dispatches %lld\n");
+        });
+        auto dump = core::CreateFunction(DumpFunc, [=](Function* f, BasicBlock*) {
+            report("stats sp_max=%lld sp_size=%lld rsp_max=%lld rsp_size=%lld here_max=%lld here_size=%lld"
+                   " input_max=%lld input_size=%lld words=%lld words_size=%lld"
+                   " created=%lld name_bytes=%lld header_bytes=%lld dispatches=%lld\n");
+        });
+        core::CreateFunction(ExitFunc, [=](Function* f, BasicBlock*) {
+            auto dump_block = core::CreateBasicBlock("dump", f);
+            auto end = core::CreateBasicBlock("end", f);
+            auto at_exit = core::Builder.CreateLoad(AtExit);
+            core::Builder.CreateCondBr(core::Builder.CreateICmpNE(at_exit, core::GetInt(0)), dump_block, end);
+            core::Builder.SetInsertPoint(dump_block);
+            core::CallFunction(DumpFunc);
+            core::Builder.CreateBr(end);
+            core::Builder.SetInsertPoint(end);
+            core::Builder.CreateRetVoid();
+        });
+
+        core::Builder.SetInsertPoint(entry);
+        core::Builder.CreateStore(core::CallFunction(InstallHandlerFunc, {dump}), AtExit);
+        engine::NextHooks.push_back(Record);
+    }
+}
+
+#endif //LLFORTH_STATS_H
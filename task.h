@@ -0,0 +1,140 @@
+#ifndef LLFORTH_TASK_H
+#define LLFORTH_TASK_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "stack.h"
+
+// Cooperative tasks. A switch saves the VM registers of the current task into the task
+// tables, picks the next ready task round-robin and restores its registers before going
+// back to next. Task 0 is the main task, which resumes when no task is ready.
+namespace task {
+    enum State {
+        Free, Ready, Stopped,
+    };
+
+    static Constant* SPs;
+    static Constant* RSPs;
+    static Constant* FSPs;
+    static Constant* PCs;
+    static Constant* States;
+    static Constant* Entry;
+    static uint64_t EntryColon;
+
+    static Value* GetSlot(Constant* table, Value* tid) {
+        return core::Builder.CreateGEP(table, {core::GetIndex(0), tid});
+    }
+
+    static void SetState(Value* tid, State state) {
+        core::Builder.CreateStore(core::GetInt(state), GetSlot(States, tid));
+    }
+
+    static Value* GetCurrent() {
+        return core::Builder.CreateLoad(stack::CurrentTask);
+    }
+
+    // Readies the task tid if it is stopped. A tid outside the task tables is ignored.
+    static void Wake(Value* tid) {
+        auto is_valid = core::Builder.CreateICmpULT(tid, core::GetInt(stack::MaxTasks));
+        auto index = core::Builder.CreateSelect(is_valid, core::Builder.CreateTrunc(tid, core::IndexType), core::GetIndex(0));
+        auto slot = GetSlot(States, index);
+        auto state = core::Builder.CreateLoad(slot);
+        auto is_stopped = core::Builder.CreateAnd(is_valid, core::Builder.CreateICmpEQ(state, core::GetInt(Stopped)));
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_stopped, core::GetInt(Ready), state), slot);
+    }
+
+    // Returns the first task after `from` in round-robin order whose state is `state`, or `fallback`
+    static Value* CreateFind(const std::string& name, Value* from, State state, Constant* fallback) {
+        auto before = core::Builder.GetInsertBlock();
+        auto loop = core::CreateBasicBlock(name + "_loop", engine::MainFunction);
+        auto check = core::CreateBasicBlock(name + "_check", engine::MainFunction);
+        auto end = core::CreateBasicBlock(name + "_end", engine::MainFunction);
+        core::Builder.CreateBr(loop);
+
+        core::Builder.SetInsertPoint(loop);
+        auto i = core::Builder.CreatePHI(core::IndexType, 2);
+        i->addIncoming(core::GetIndex(1), before);
+        auto is_end = core::Builder.CreateICmpUGT(i, core::GetIndex(stack::MaxTasks));
+        core::Builder.CreateCondBr(is_end, end, check);
+
+        core::Builder.SetInsertPoint(check);
+        auto tid = core::Builder.CreateURem(core::Builder.CreateAdd(from, i), core::GetIndex(stack::MaxTasks));
+        auto is_found = core::Builder.CreateICmpEQ(core::Builder.CreateLoad(GetSlot(States, tid)), core::GetInt(state));
+        i->addIncoming(core::Builder.CreateAdd(i, core::GetIndex(1)), check);
+        core::Builder.CreateCondBr(is_found, end, loop);
+
+        core::Builder.SetInsertPoint(end);
+        auto found = core::Builder.CreatePHI(core::IndexType, 2);
+        found->addIncoming(fallback, loop);
+        found->addIncoming(tid, check);
+        return found;
+    }
+
+    static void Switch(const std::string& name) {
+        auto current = GetCurrent();
+        core::Builder.CreateStore(core::Builder.CreateLoad(stack::SP), GetSlot(SPs, current));
+        core::Builder.CreateStore(core::Builder.CreateLoad(stack::RSP), GetSlot(RSPs, current));
+        core::Builder.CreateStore(core::Builder.CreateLoad(stack::FSP), GetSlot(FSPs, current));
+        core::Builder.CreateStore(core::Builder.CreateLoad(engine::PC), GetSlot(PCs, current));
+
+        auto next = CreateFind(name, current, Ready, core::GetIndex(0));
+        core::Builder.CreateStore(core::Builder.CreateLoad(GetSlot(SPs, next)), stack::SP);
+        core::Builder.CreateStore(core::Builder.CreateLoad(GetSlot(RSPs, next)), stack::RSP);
+        core::Builder.CreateStore(core::Builder.CreateLoad(GetSlot(FSPs, next)), stack::FSP);
+        core::Builder.CreateStore(core::Builder.CreateLoad(GetSlot(PCs, next)), engine::PC);
+        core::Builder.CreateStore(next, stack::CurrentTask);
+        engine::CreateBrNext();
+    }
+
+    // Takes a free task, which starts at the entry code with xt on its empty stack. Pushes -1 when every task is taken.
+    static void Create(const std::string& name, Value* xt) {
+        auto tid = CreateFind(name, core::GetIndex(0), Free, core::GetIndex(-1));
+        auto init = core::CreateBasicBlock(name + "_init", engine::MainFunction);
+        auto full = core::CreateBasicBlock(name + "_full", engine::MainFunction);
+        core::Builder.CreateCondBr(core::Builder.CreateICmpEQ(tid, core::GetIndex(-1)), full, init);
+
+        core::Builder.SetInsertPoint(init);
+        auto base = core::Builder.CreateMul(tid, core::GetIndex(stack::StackSize));
+        core::Builder.CreateStore(xt, core::Builder.CreateGEP(stack::Stack, {core::GetIndex(0), base}));
+        core::Builder.CreateStore(core::Builder.CreateAdd(base, core::GetIndex(1)), GetSlot(SPs, tid));
+        core::Builder.CreateStore(base, GetSlot(RSPs, tid));
+        core::Builder.CreateStore(base, GetSlot(FSPs, tid));
+        core::Builder.CreateStore(core::Builder.CreateLoad(Entry), GetSlot(PCs, tid));
+        SetState(tid, Ready);
+        stack::Push(core::Builder.CreateIntCast(tid, core::IntType, false));
+        engine::CreateBrNext();
+
+        core::Builder.SetInsertPoint(full);
+        stack::Push(core::GetInt(-1));
+        engine::CreateBrNext();
+    }
+
+    // The entry code is a colon body compiled after execute, so its address is only known then
+    static void SetEntry(uint64_t colon) {
+        EntryColon = colon;
+    }
+
+    // After dict::MoveBodies, which may have moved the entry code
+    static void Finalize() {
+        Constant* idx[] = {core::GetIndex(0), core::GetIndex(dict::GetMoved(EntryColon))};
+        auto pc = ConstantExpr::getInBoundsGetElementPtr(dict::GetMemoryType(), dict::Memory, idx);
+        Entry = core::CreateGlobalVariable("task_entry", dict::CodePtrType, pc);
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        auto index_table = ArrayType::get(core::IndexType, stack::MaxTasks);
+        SPs = core::CreateGlobalVariable("task_sp", index_table, Constant::getNullValue(index_table), false);
+        RSPs = core::CreateGlobalVariable("task_rsp", index_table, Constant::getNullValue(index_table), false);
+        FSPs = core::CreateGlobalVariable("task_fsp", index_table, Constant::getNullValue(index_table), false);
+        auto pc_table = ArrayType::get(dict::CodePtrType, stack::MaxTasks);
+        PCs = core::CreateGlobalVariable("task_pc", pc_table, Constant::getNullValue(pc_table), false);
+        std::vector<Constant*> states(stack::MaxTasks, core::GetInt(Free));
+        states[0] = core::GetInt(Ready);
+        States = core::CreateGlobalArrayVariable("task_state", core::IntType, states, false);
+        Entry = core::CreateGlobalVariable("task_entry", dict::CodePtrType);
+        engine::Finalizers.push_back(Finalize);
+    }
+}
+
+#endif //LLFORTH_TASK_H
@@ -0,0 +1,29 @@
+#include <cstdio>
+#include <cstring>
+#include "llforth.h"
+
+static int64_t eval(llforth_vm* vm, const char* source) {
+    return llforth_eval(vm, source, strlen(source));
+}
+
+int main() {
+    auto vm = llforth_create();
+    printf("second %d\n", llforth_create() == nullptr);
+
+    eval(vm, "3 sq");
+    printf("sq %lld\n", (long long)llforth_pop(vm));
+
+    eval(vm, ": cube\n dup sq * ;");
+    auto cube = llforth_find(vm, "cube", 4);
+    llforth_push(vm, 3);
+    llforth_call(vm, cube);
+    printf("cube %lld\n", (long long)llforth_pop(vm));
+
+    printf("throw %lld\n", (long long)eval(vm, "1 2 7 throw 4"));
+    printf("depth %lld\n", (long long)llforth_depth(vm));
+    eval(vm, "+ .");
+    fflush(stdout);
+
+    llforth_destroy(vm);
+    return 0;
+}
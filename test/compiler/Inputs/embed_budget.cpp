@@ -0,0 +1,30 @@
+#include <cstdio>
+#include "llforth.h"
+
+int main() {
+    auto vm = llforth_create();
+    auto count = llforth_find(vm, "count", 5);
+
+    llforth_budget(vm, 100);
+    auto code = llforth_call(vm, count);
+    printf("stopped %d\n", code == LLFORTH_BUDGET_EXHAUSTED);
+    int resumes = 0;
+    while (code == LLFORTH_BUDGET_EXHAUSTED) {
+        resumes++;
+        llforth_budget(vm, 100);
+        code = llforth_resume(vm);
+    }
+    printf("resumed %d %lld\n", resumes, (long long)llforth_pop(vm));
+
+    llforth_budget(vm, 100);
+    llforth_call(vm, count);
+    printf("stays %d\n", llforth_call(vm, count) == LLFORTH_BUDGET_EXHAUSTED);
+
+    llforth_budget(vm, 0);
+    code = llforth_call(vm, count);
+    printf("unlimited %lld %lld\n", (long long)code, (long long)llforth_pop(vm));
+    printf("nothing %lld\n", (long long)llforth_resume(vm));
+
+    llforth_destroy(vm);
+    return 0;
+}
@@ -0,0 +1,25 @@
+\ RUN: llforthc --budget %s | %{link} %t && %t | FileCheck %s
+\ RUN: env LLFORTH_BUDGET=499 %t | FileCheck %s
+\ RUN: env LLFORTH_BUDGET=498 %t; test $? -eq 255
+\ RUN: env LLFORTH_BUDGET=100 %t; test $? -eq 255
+\ RUN: env LLFORTH_BUDGET=lots %t; test $? -eq 2
+
+\ main starts without docol and takes the backward branch 499 times, so a budget of 499 is
+\ just enough
+
+: main
+
+0
+.loop:
+1 +
+dup 500 <>
+0branch .done
+branch .loop
+
+.done:
+.
+bye
+
+;
+
+\ CHECK: 500
@@ -0,0 +1,22 @@
+\ RUN: llforthc --embed %s | %{embed} %t %S/Inputs/embed.cpp && %t | FileCheck %s
+
+: evaluate
+    (evaluate)
+
+.start:
+    interpret
+    inbuf@ -1 <>
+    0branch .end
+    branch .start
+
+.end:
+;
+
+: sq dup * ;
+
+\ CHECK: second 1
+\ CHECK: sq 9
+\ CHECK: cube 27
+\ CHECK: throw 7
+\ CHECK: depth 2
+\ CHECK: 3
@@ -0,0 +1,31 @@
+\ RUN: llforthc --embed --budget %s | %{embed} %t %S/Inputs/embed_budget.cpp && %t | FileCheck %s
+
+: evaluate
+    (evaluate)
+
+.start:
+    interpret
+    inbuf@ -1 <>
+    0branch .end
+    branch .start
+
+.end:
+;
+
+: count
+    0
+
+.loop:
+    1 +
+    dup 1000 <>
+    0branch .done
+    branch .loop
+
+.done:
+;
+
+\ CHECK: stopped 1
+\ CHECK: resumed {{[1-9][0-9]*}} 1000
+\ CHECK: stays 1
+\ CHECK: unlimited 0 1000
+\ CHECK: nothing 0
@@ -0,0 +1,19 @@
+\ RUN: %{compile} %t && %t | FileCheck %s
+
+: main
+
+pipe .
+over readable watch .
+0 event-wait . .
+dup s" ping" rot fd-write . .
+0 event-wait . .
+0 event@ . drop
+over inbuf 1024 rot fd-read . dup .
+inbuf swap type
+over inbuf 1024 rot fd-read would-block = . .
+fd-close . fd-close .
+bye
+
+;
+
+\ CHECK: 0 0 0 0 0 4 0 1 1 0 4 ping-1 0 0 0
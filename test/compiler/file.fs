@@ -0,0 +1,27 @@
+\ RUN: %{compile} %t && rm -rf %t.dir && mkdir %t.dir && cd %t.dir && %t | FileCheck %s
+
+: main
+
+s" file.txt" w/o create-file .
+dup s" hello" rot write-file .
+close-file .
+
+s" file.txt" r/o open-file .
+dup inbuf 1024 rot read-line
+. . dup .
+inbuf swap type
+close-file .
+
+s" file.txt" r/w open-file .
+dup inbuf 2 rot read-file . .
+dup s" LLO" rot write-file .
+close-file .
+
+s" file.txt" map-file .
+over over type
+unmap-file .
+bye
+
+;
+
+\ CHECK: 0 0 0 0 0 -1 5 hello0 0 0 2 0 0 0 heLLO0
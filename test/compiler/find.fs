@@ -4,8 +4,8 @@
 
 9999999
 inbuf word
-.
-inbuf find
+dup .
+inbuf swap find
 execute
 bye
 
@@ -0,0 +1,15 @@
+\ RUN: %{compile} %t && %t | FileCheck %s
+
+: main
+
+1.5 2.25 f+ f.
+10 s>f 4.0 f/ f.
+2.0 fsqrt 2.0 fsqrt f* f>s .
+3e fdup f* f.
+1.0 2.0 fswap f. f.
+here@ 0 , 7.5 dup f! f@ f.
+bye
+
+;
+
+\ CHECK: 3.75 2.5 2 9 1 2 7.5
@@ -0,0 +1,14 @@
+\ RUN: llforthc --tokens %S/../../interpreter.fs | %{link} %t
+\ RUN: printf ': sq dup * ;\n7 ,\n' > %t.plain.fs
+\ RUN: rm -f %t.plain.fs.cache
+\ RUN: echo "include %t.plain.fs 3 sq . bye" | %t | FileCheck %s
+\ RUN: test -f %t.plain.fs.cache
+\ RUN: printf ': sq dup * ;\n: tick inbuf word inbuf swap find ;\ntick sq ,\n' > %t.xt.fs
+\ RUN: rm -f %t.xt.fs.cache
+\ RUN: echo "include %t.xt.fs 3 sq . bye" | %t | FileCheck %s
+\ RUN: test ! -f %t.xt.fs.cache
+
+\ With --tokens , writes a data cell across two raw code cells, so an xt stored with it can
+\ only be told from two inline literals by joining them again
+
+\ CHECK: 9
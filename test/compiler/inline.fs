@@ -0,0 +1,25 @@
+\ RUN: llforthc --verbose %s 2>&1 >/dev/null | FileCheck --check-prefix=CODE %s
+\ RUN: %{compile} %t && %t | FileCheck %s
+
+: sq
+dup *
+;
+
+: abs
+dup 0 <
+0branch .done
+0 swap -
+.done:
+; inline
+
+: main
+
+3 sq .
+-4 abs . 5 abs .
+4 ' sq execute .
+bye
+
+;
+
+\ CODE: main lit 3 dup * . lit -4 dup lit 0 < 0branch abs@7.done lit 0 swap - . lit 5 dup lit 0 < 0branch abs@19.done lit 0 swap - . lit 4 lit sq execute . bye exit
+\ CHECK: 9 4 5 16
@@ -1,3 +1,5 @@
+import os
+
 import lit.formats
 
 config.name = "llforthc"
@@ -5,4 +7,7 @@ config.test_format = lit.formats.ShTest()
 config.suffixes = ['.fs']
 
 liblib = lit_config.params.get('lib')
-config.substitutions.append(('%{compile}', 'llforthc %s | llc -filetype=obj -o %t.o && clang++ %t.o {} -o'.format(liblib)))
+ldflags = lit_config.params.get('ldflags', '')
+config.substitutions.append(('%{compile}', 'llforthc %s | %{link}'))
+config.substitutions.append(('%{embed}', 'llc -filetype=obj -o %t.o && clang++ -I{0} {0}/libllforth.cpp %t.o {1} {2} -o'.format(os.path.join(config.test_source_root, '..', '..'), liblib, ldflags)))
+config.substitutions.append(('%{link}', 'llc -filetype=obj -o %t.o && clang++ %t.o {} {} -o'.format(liblib, ldflags)))
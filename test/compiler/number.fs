@@ -3,7 +3,7 @@
 : main
 
 inbuf word
-inbuf number
+inbuf swap number
 .
 bye
 
@@ -0,0 +1,13 @@
+\ RUN: llforthc --perf-symbols %s | %{link} %t && llvm-nm %t | FileCheck %s && %t | FileCheck --check-prefix=OUTPUT %s
+
+: main
+
+1 2 + .
+bye
+
+;
+
+\ CHECK-DAG: forth.+.{{[0-9]+}}
+\ CHECK-DAG: forth.dup.{{[0-9]+}}
+\ CHECK-DAG: forth.next.{{[0-9]+}}
+\ OUTPUT: 3
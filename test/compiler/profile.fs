@@ -0,0 +1,41 @@
+\ RUN: llforthc --profile-generate %s | %{link} %t && env LLFORTH_PROFILE=%t.profile %t | FileCheck --check-prefix=OUTPUT %s
+\ RUN: FileCheck --check-prefix=PROFILE %s < %t.profile
+\ RUN: llforthc --profile-use %t.profile %s 2> %t.candidates > %t.ll
+\ RUN: FileCheck --check-prefix=USE %s < %t.ll && FileCheck --check-prefix=CANDIDATES %s < %t.candidates
+\ RUN: cat %t.ll | %{link} %t.use && %t.use | FileCheck --check-prefix=OUTPUT %s
+\ RUN: FileCheck --check-prefix=NOCOUNT %s < %t.ll
+\ RUN: llforthc %s | FileCheck --check-prefix=NOCOUNT %s
+
+: cold
+1 2 3 drop drop drop
+;
+
+: hot
+1 dup + drop
+;
+
+: main
+
+cold
+10
+
+.loop:
+hot
+1 - dup
+0branch .done
+branch .loop
+
+.done:
+. bye
+
+;
+
+\ OUTPUT: 0
+\ PROFILE: word {{[0-9]+}} cold 1
+\ PROFILE: word {{[0-9]+}} hot 10
+\ PROFILE: branch 1 9
+\ USE-DAG: indirectbr {{.*}} !prof
+\ USE-DAG: label %i_branch, label %i_skip, !prof [[WEIGHTS:![0-9]+]]
+\ USE-DAG: [[WEIGHTS]] = !{!"branch_weights", i32 2, i32 10}
+\ CANDIDATES: superinstruction candidate: dup + 10
+\ NOCOUNT-NOT: @profile_
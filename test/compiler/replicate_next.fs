@@ -0,0 +1,16 @@
+\ RUN: llforthc --replicate-next %s | %{link} %t && %t | FileCheck %s
+
+: square dup * ;
+
+: main
+
+3 square .
+1
+0branch .end
+4 square .
+.end:
+bye
+
+;
+
+\ CHECK: 9 16
@@ -0,0 +1,23 @@
+\ RUN: llforthc --shake %s > %t.ll
+\ RUN: FileCheck %s < %t.ll && FileCheck --check-prefix=DROPPED %s < %t.ll
+\ RUN: cat %t.ll | %{link} %t && %t | FileCheck --check-prefix=OUTPUT %s
+\ RUN: llforthc --tokens --shake %s | %{link} %t.tokens && %t.tokens | FileCheck --check-prefix=OUTPUT %s
+
+: sq
+dup *
+;
+
+: main
+
+3 sq .
+4 ' sq execute .
+bye
+
+;
+
+\ CHECK-DAG: i_dup:
+\ CHECK-DAG: i_execute:
+\ CHECK-DAG: c"sq\00"
+\ DROPPED-NOT: i_emit:
+\ DROPPED-NOT: c"emit\00"
+\ OUTPUT: 9 16
@@ -0,0 +1,26 @@
+\ RUN: llforthc --stats %s | %{link} %t && %t 2>&1 | FileCheck %s
+\ RUN: env LLFORTH_STATS=1 %t 2>&1 | FileCheck --check-prefix=DUMP %s
+
+: three
+1 2 3
+;
+
+: main
+
+three drop drop drop .stats
+bye
+
+;
+
+\ CHECK: -- stats --
+\ CHECK-NEXT: stack 3/1024 cells
+\ CHECK-NEXT: rstack 1/1024 cells
+\ CHECK-NEXT: dict {{[0-9]+}}/1024 cells
+\ CHECK-NEXT: input 0/1024 bytes
+\ CHECK-NEXT: words {{[0-9]+}}/1024
+\ CHECK-NEXT: created 0 words, 0 name bytes, 0 header bytes
+\ CHECK-NEXT: dispatches 9
+\ CHECK-NOT: stats sp_max
+
+\ DUMP: dispatches 9
+\ DUMP: stats sp_max=3 sp_size=1024 rsp_max=1 rsp_size=1024 here_max={{[0-9]+}} here_size=1024 input_max=0 input_size=1024 words={{[0-9]+}} words_size=1024 created=0 name_bytes=0 header_bytes=0 dispatches=10
@@ -0,0 +1,19 @@
+\ RUN: %{compile} %t && %t | FileCheck %s
+
+: ping 1 . pause 2 . pause 3 . ;
+: pong 10 . pause 20 . ;
+: sleeper 5 . stop 6 . ;
+
+: main
+
+' ping task drop
+' pong task drop
+pause pause pause pause
+' sleeper task
+pause 7 . wake pause 8 .
+-1 wake 4294967296 wake 9 .
+bye
+
+;
+
+\ CHECK: 1 10 2 20 3 5 7 6 8 9
@@ -0,0 +1,35 @@
+\ RUN: llforthc --tokens %s | %{link} %t && %t | FileCheck %s
+
+: square dup * ;
+
+: main
+
+3 square .
+-7 .
+1.5 f.
+." hi"
+2 ' square execute .
+
+3
+.loop:
+dup .
+1 -
+dup
+0branch .done
+branch .loop
+.done:
+drop
+
+s" big" swap create
+' 0branch compile, here@ 0 branch,
+1000000 dup * literal 7 literal ' + compile,
+here swap branch!
+3 literal
+' exit compile,
+1 s" big" find execute . .
+0 s" big" find execute .
+bye
+
+;
+
+\ CHECK: 9 -7 1.5 hi4 3 2 1 3 1000000000007 3
@@ -0,0 +1,14 @@
+\ RUN: llforthc --trace %s | %{link} %t && %t 2>&1 | FileCheck %s
+
+: main
+
+1 2 + .trace
+bye
+
+;
+
+\ CHECK: -- trace --
+\ CHECK-NEXT: lit pc={{[0-9]+}} sp=0 tos=0
+\ CHECK-NEXT: lit pc={{[0-9]+}} sp=1 tos=1
+\ CHECK-NEXT: + pc={{[0-9]+}} sp=2 tos=2
+\ CHECK-NEXT: .trace pc={{[0-9]+}} sp=1 tos=3
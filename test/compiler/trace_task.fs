@@ -0,0 +1,15 @@
+\ RUN: llforthc --trace %s | %{link} %t && %t 2>&1 | FileCheck %s
+
+: traced 4 .trace ;
+
+: main
+
+1 2 3
+' traced task drop
+pause
+bye
+
+;
+
+\ CHECK: -- trace --
+\ CHECK: .trace pc={{[0-9]+}} sp=1 tos=4
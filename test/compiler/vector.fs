@@ -0,0 +1,25 @@
+\ RUN: %{compile} %t && %t | FileCheck %s
+\ RUN: llforthc --tokens %s | %{link} %t.tokens && %t.tokens | FileCheck %s
+
+: main
+
+\ Start the vectors on an odd code cell, which with --tokens is only 4-byte aligned
+here dup 2 / 2 * <>
+0branch .pad
+branch .vectors
+.pad:
+' exit compile,
+.vectors:
+
+here@ 1 , 2 , 3 , 4 , 5 ,
+dup 5 vsum .
+dup dup 5 vdot .
+dup 5 vmin . dup 5 vmax .
+dup 5 2 vscale dup 5 vsum .
+dup dup here@ 5 vadd here@ 5 vsum .
+dup 5 vscan 32 + @ .
+bye
+
+;
+
+\ CHECK: 15 55 1 5 30 60 30
@@ -3,8 +3,8 @@
 : main
 
 inbuf word
-.
-inbuf prints
+dup .
+inbuf swap type
 bye
 
 ;
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Usage: serve.sh TMP
+# Loads a library into llforth --serve and runs scripts on it through llforth-client.
+sock=$1.sock
+rm -f "$sock"
+printf ': sq dup * ;\n' > "$1.lib.fs"
+llforth --serve "$sock" "$1.lib.fs" &
+server=$!
+# Waits up to 10s for the socket, and gives up at once if the server died
+tries=0
+while [ ! -S "$sock" ]; do
+    if ! kill -0 $server 2>/dev/null; then
+        echo "llforth --serve exited" >&2
+        exit 1
+    fi
+    tries=$((tries + 1))
+    if [ $tries -ge 100 ]; then
+        echo "llforth --serve did not create $sock" >&2
+        kill $server
+        exit 1
+    fi
+    sleep 0.1
+done
+
+echo '3 sq .' | llforth-client "$sock"
+echo "status $?"
+echo '4 sq . 9 throw' | llforth-client "$sock"
+echo "status $?"
+
+kill $server
+rm -f "$sock"
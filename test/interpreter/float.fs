@@ -0,0 +1,8 @@
+\ RUN: %{run} | FileCheck %s
+
+1.5 2.5 f+ f.
+: half 2.0 f/ ; 5.0 half f.
+bye
+
+\ CHECK: 4
+\ CHECK: 2.5
@@ -0,0 +1,18 @@
+\ RUN: %{run} | FileCheck %s
+
+: a 1 ;
+here
+marker scratch
+: b ." b" ;
+: a 3 ;
+a . b
+scratch
+a .
+here = .
+here : c 5 ; c . forget c here = .
+bye
+
+\ CHECK: 3 b
+\ CHECK: 1
+\ CHECK: -1
+\ CHECK: 5 -1
@@ -0,0 +1,11 @@
+\ RUN: printf ': sq dup * ;\n: hi ." hi" ;\n' > %t.fs
+\ RUN: rm -f %t.fs.cache
+\ RUN: echo "include %t.fs 3 sq . hi bye" | llforth | FileCheck %s
+\ RUN: test -f %t.fs.cache
+\ RUN: echo "include %t.fs 4 sq . hi bye" | llforth | FileCheck --check-prefix=CACHED %s
+\ RUN: printf ': sq dup dup * * ;\n' > %t.fs
+\ RUN: echo "include %t.fs 2 sq . bye" | llforth | FileCheck --check-prefix=CHANGED %s
+
+\ CHECK: 9 hi
+\ CACHED: 16 hi
+\ CHANGED: 8
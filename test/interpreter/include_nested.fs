@@ -0,0 +1,20 @@
+\ RUN: printf ': inner 1 ;\n' > %t.inner.fs
+\ RUN: printf 'include %t.inner.fs\n: outer inner 10 + ;\n' > %t.outer.fs
+\ RUN: rm -f %t.inner.fs.cache %t.outer.fs.cache
+\ RUN: echo "include %t.outer.fs outer . bye" | llforth | FileCheck %s
+\ RUN: test -f %t.outer.fs.cache
+\ RUN: echo "include %t.outer.fs outer . bye" | llforth | FileCheck %s
+\ RUN: printf ': inner 2 ;\n' > %t.inner.fs
+\ RUN: echo "include %t.outer.fs outer . bye" | llforth | FileCheck --check-prefix=INNER %s
+
+\ RUN: printf ': base 1 ; inline\n' > %t.base.fs
+\ RUN: printf ': use base 100 + ;\n' > %t.use.fs
+\ RUN: rm -f %t.base.fs.cache %t.use.fs.cache
+\ RUN: echo "include %t.base.fs include %t.use.fs use . bye" | llforth | FileCheck --check-prefix=BEFORE %s
+\ RUN: printf ': base 2 ; inline\n' > %t.base.fs
+\ RUN: echo "include %t.base.fs include %t.use.fs use . bye" | llforth | FileCheck --check-prefix=BEFORE-CHANGED %s
+
+\ CHECK: 11
+\ INNER: 12
+\ BEFORE: 101
+\ BEFORE-CHANGED: 102
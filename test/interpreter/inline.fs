@@ -0,0 +1,14 @@
+\ RUN: %{run} | FileCheck %s
+
+: 3* 3 * ; inline
+: f 2 3* ;
+f .
+: 3* 4 * ;
+2 3* . f .
+: count 0 begin 1+ dup . dup 3 = until drop ;
+count
+bye
+
+\ CHECK: 6
+\ CHECK: 8 6
+\ CHECK: 1 2 3
@@ -0,0 +1,20 @@
+\ RUN: %{run} | FileCheck %s
+
+: sq dup * ;
+3 sq .
+: big 1000000 dup * ;
+big 7 + .
+: sign 0< if -1 else 1 then ;
+-5 sign . 5 sign .
+: hi ." hi" ;
+hi
+: sq 1 + ; 4 sq .
+: half 2.0 f/ ; 5.0 half f.
+bye
+
+\ CHECK: 9
+\ CHECK: 1000000000007
+\ CHECK: -1 1
+\ CHECK: hi
+\ CHECK: 5
+\ CHECK: 2.5
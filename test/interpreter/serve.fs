@@ -0,0 +1,6 @@
+\ RUN: sh %S/Inputs/serve.sh %t | FileCheck %s
+
+\ CHECK: 9
+\ CHECK: status 0
+\ CHECK: 16
+\ CHECK: status 9
@@ -0,0 +1,97 @@
+#ifndef LLFORTH_TRACE_H
+#define LLFORTH_TRACE_H
+
+#include "core.h"
+#include "engine.h"
+#include "dict.h"
+#include "stack.h"
+#include "kernel.h"
+#include "util.h"
+
+// Execution trace for `llforthc --trace`. The next block records every dispatch into a
+// ring buffer of TraceSize entries, which is dumped to stderr on throw, on a fatal
+// signal or by `.trace`. Without --trace nothing is recorded, dispatch is unchanged and
+// neither trace_dump nor `.trace` exist.
+namespace trace {
+    const static uint64_t TraceSize = 256; // Must be a power of two
+    static bool Enabled = false;
+
+    static StructType* CreateEntryType() {
+        auto entry_type = StructType::create(core::TheContext, "trace_entry");
+        entry_type->setBody({
+            dict::XtPtrType,  // Dispatched xt
+            core::IntType,    // Index of the cell holding the xt on main memory array
+            core::IndexType,  // Depth of the data stack of the running task
+            core::IntType,    // Top of stack, 0 when empty
+        });
+        return entry_type;
+    };
+    const static auto EntryType = CreateEntryType();
+    enum EntryMember {
+        EntryXt, EntryPC, EntrySP, EntryTos,
+    };
+
+    static Constant* Buffer;
+    static Constant* Count;
+
+    const static core::Func DumpFunc {
+        "trace_dump", FunctionType::get(core::VoidType, {}, false)
+    };
+    const static core::Func InstallHandlerFunc {
+        "install_trace_handler", FunctionType::get(core::VoidType, {DumpFunc.type->getPointerTo()}, false)
+    };
+
+    static Value* GetEntryMember(Value* slot, EntryMember member) {
+        return core::Builder.CreateGEP(Buffer, {core::GetInt(0), slot, core::GetIndex(member)});
+    }
+
+    static void Record() {
+        auto count = core::Builder.CreateLoad(Count);
+        auto slot = core::Builder.CreateAnd(count, core::GetInt(TraceSize - 1));
+        auto pc = core::Builder.CreatePtrDiff(core::Builder.CreateLoad(engine::PC), core::CreateConstantGEP(dict::Memory));
+        auto sp = core::Builder.CreateLoad(stack::SP);
+        auto depth = core::Builder.CreateSub(sp, stack::GetBase());
+        auto is_empty = core::Builder.CreateICmpEQ(depth, core::GetIndex(0));
+        auto top_sp = core::Builder.CreateSelect(is_empty, core::GetIndex(0), core::Builder.CreateSub(sp, core::GetIndex(1)));
+        auto top = core::Builder.CreateLoad(core::Builder.CreateGEP(stack::Stack, {core::GetIndex(0), top_sp}));
+        core::Builder.CreateStore(dict::GetXt(), GetEntryMember(slot, EntryXt));
+        core::Builder.CreateStore(core::Builder.CreateSub(pc, core::GetInt(1)), GetEntryMember(slot, EntryPC));
+        core::Builder.CreateStore(depth, GetEntryMember(slot, EntrySP));
+        core::Builder.CreateStore(core::Builder.CreateSelect(is_empty, core::GetInt(0), top), GetEntryMember(slot, EntryTos));
+        core::Builder.CreateStore(core::Builder.CreateAdd(count, core::GetInt(1)), Count);
+    }
+
+    static void Initialize(Function* main, BasicBlock* entry) {
+        if (!Enabled) { return; }
+        auto buffer_type = ArrayType::get(EntryType, TraceSize);
+        Buffer = core::CreateGlobalVariable("trace_buffer", buffer_type, Constant::getNullValue(buffer_type), false);
+        Count = core::CreateGlobalVariable("trace_count", core::IntType, core::GetInt(0), false);
+
+        auto dump = core::CreateFunction(DumpFunc, [=](Function* f, BasicBlock*) {
+            auto buffer = util::CreateErrorBuffer();
+            util::CreateWriteError(buffer, "-- trace --\n", {});
+            auto count = core::Builder.CreateLoad(Count);
+            auto is_wrapped = core::Builder.CreateICmpUGT(count, core::GetInt(TraceSize));
+            auto start = core::Builder.CreateSelect(is_wrapped, core::Builder.CreateSub(count, core::GetInt(TraceSize)), core::GetInt(0));
+            kernel::CreateLoop(f, "dump", start, count, 1, {}, [=](Value* index, const kernel::Values&) -> kernel::Values {
+                auto slot = core::Builder.CreateAnd(index, core::GetInt(TraceSize - 1));
+                auto xt = core::Builder.CreateLoad(GetEntryMember(slot, EntryXt));
+                auto length = core::Builder.CreateIntCast(dict::GetXtWordLength(xt), core::Builder.getInt32Ty(), false);
+                util::CreateWriteError(buffer, "%.*s pc=%lld sp=%d tos=%lld\n", {
+                        length, dict::GetXtWord(xt),
+                        core::Builder.CreateLoad(GetEntryMember(slot, EntryPC)),
+                        core::Builder.CreateLoad(GetEntryMember(slot, EntrySP)),
+                        core::Builder.CreateLoad(GetEntryMember(slot, EntryTos)),
+                });
+                return {};
+            });
+            core::Builder.CreateRetVoid();
+        });
+
+        core::Builder.SetInsertPoint(entry);
+        core::CallFunction(InstallHandlerFunc, {dump});
+        engine::NextHooks.push_back(Record);
+    }
+}
+
+#endif //LLFORTH_TRACE_H
@@ -11,14 +11,22 @@
 namespace util {
     const static auto NullChar = ConstantInt::get(core::CharType, 0);
 
+    // Last xt found for each name hash. An entry is only used when its name matches, and create
+    // overwrites the entry of the name it defines, so a newer word always shadows the cached one.
+    const static uint64_t FindCacheSize = 256;
+    static Constant* FindCache;
+
     const static core::Func PrintIntFunc {
         "print_int", FunctionType::get(core::VoidType, {core::IntType}, false)
     };
+    const static core::Func PrintFloatFunc {
+        "print_float", FunctionType::get(core::VoidType, {core::FloatType}, false)
+    };
     const static core::Func PrintCharFunc {
         "print_char", FunctionType::get(core::VoidType, {core::IntType}, false)
     };
     const static core::Func PrintStrFunc {
-        "print_str", FunctionType::get(core::VoidType, {core::StrType}, false)
+        "print_str", FunctionType::get(core::VoidType, {core::StrType, core::IntType}, false)
     };
     const static core::Func CreateReaderFunc {
         "create_reader", FunctionType::get(core::PtrType, {core::IntType, core::StrPtrType}, false)
@@ -26,25 +34,166 @@ namespace util {
     const static core::Func ReadWordFromReaderFunc {
         "read_word_from_reader", FunctionType::get(core::IntType, {core::PtrType, core::StrType, core::IntType}, false)
     };
+    const static core::Func ReaderEvaluateFunc {
+        "reader_evaluate", FunctionType::get(core::VoidType, {core::PtrType, core::StrType, core::IntType}, false)
+    };
     const static core::Func DestroyReaderFunc {
         "destroy_reader", FunctionType::get(core::VoidType, {core::PtrType}, false)
     };
     const static core::Func FindXtFunc {
-        "find_xt", FunctionType::get(dict::XtPtrType, {core::StrType}, false)
+        "find_xt", FunctionType::get(dict::XtPtrType, {core::StrType, core::IntType}, false)
+    };
+    const static core::Func HashNameFunc {
+        "hash_name", FunctionType::get(core::IndexType, {core::StrType, core::IntType}, false)
+    };
+    const static core::Func FindXtCachedFunc {
+        "find_xt_cached", FunctionType::get(dict::XtPtrType, {core::StrType, core::IntType}, false)
     };
     const static core::Func StringToIntFunc {
-        "string_to_int", FunctionType::get(core::IntType, {core::StrType}, false)
+        "string_to_int", FunctionType::get(core::IntType, {core::StrType, core::IntType}, false)
+    };
+    const static core::Func StringToFloatFunc {
+        "string_to_float", FunctionType::get(core::FloatType, {core::StrType, core::IntType, core::IntPtrType}, false)
     };
     const static core::Func StringEqualFunc {
-        "string_equal", FunctionType::get(core::BoolType, {core::StrType, core::StrType}, false)
+        "string_equal", FunctionType::get(core::BoolType, {core::StrType, core::StrType, core::IntType}, false)
     };
     const static core::Func PrintStackFunc {
         "print_stack", FunctionType::get(core::VoidType, {core::IndexType, core::IntType->getPointerTo()}, false)
     };
+    const static core::Func UtimeFunc {
+        "get_utime", FunctionType::get(core::IntType, {}, false)
+    };
+    const static core::Func OpenFileFunc {
+        "open_file", FunctionType::get(core::PtrType, {core::StrType, core::IntType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func CreateFileFunc {
+        "create_file", FunctionType::get(core::PtrType, {core::StrType, core::IntType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func CloseFileFunc {
+        "close_file", FunctionType::get(core::IntType, {core::PtrType}, false)
+    };
+    const static core::Func ReadFileFunc {
+        "read_file", FunctionType::get(core::IntType, {core::PtrType, core::StrType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func ReadLineFunc {
+        "read_line", FunctionType::get(core::IntType, {core::PtrType, core::StrType, core::IntType, core::IntPtrType, core::IntPtrType}, false)
+    };
+    const static core::Func WriteFileFunc {
+        "write_file", FunctionType::get(core::IntType, {core::PtrType, core::StrType, core::IntType}, false)
+    };
+    const static core::Func MapFileFunc {
+        "map_file", FunctionType::get(core::StrType, {core::StrType, core::IntType, core::IntPtrType, core::IntPtrType}, false)
+    };
+    const static core::Func UnmapFileFunc {
+        "unmap_file", FunctionType::get(core::IntType, {core::StrType, core::IntType}, false)
+    };
+    const static core::Func WouldBlockFunc {
+        "would_block", FunctionType::get(core::IntType, {}, false)
+    };
+    const static core::Func FdNonblockFunc {
+        "fd_nonblock", FunctionType::get(core::IntType, {core::IntType}, false)
+    };
+    const static core::Func FdReadFunc {
+        "fd_read", FunctionType::get(core::IntType, {core::IntType, core::StrType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func FdWriteFunc {
+        "fd_write", FunctionType::get(core::IntType, {core::IntType, core::StrType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func FdCloseFunc {
+        "fd_close", FunctionType::get(core::IntType, {core::IntType}, false)
+    };
+    const static core::Func FdPipeFunc {
+        "fd_pipe", FunctionType::get(core::IntType, {core::IntPtrType, core::IntPtrType}, false)
+    };
+    const static core::Func UnixConnectFunc {
+        "unix_connect", FunctionType::get(core::IntType, {core::StrType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func UnixListenFunc {
+        "unix_listen", FunctionType::get(core::IntType, {core::StrType, core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func UnixAcceptFunc {
+        "unix_accept", FunctionType::get(core::IntType, {core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func EventWatchFunc {
+        "event_watch", FunctionType::get(core::IntType, {core::IntType, core::IntType}, false)
+    };
+    const static core::Func EventUnwatchFunc {
+        "event_unwatch", FunctionType::get(core::IntType, {core::IntType}, false)
+    };
+    const static core::Func EventWaitFunc {
+        "event_wait", FunctionType::get(core::IntType, {core::IntType, core::IntPtrType}, false)
+    };
+    const static core::Func EventGetFunc {
+        "event_get", FunctionType::get(core::IntType, {core::IntType, core::IntPtrType}, false)
+    };
     const static core::Func StringCopyFunc {
-        "string_copy", FunctionType::get(core::VoidType, {core::StrType, core::StrType}, false)
+        "string_copy", FunctionType::get(core::VoidType, {core::StrType, core::StrType, core::IntType}, false)
+    };
+
+    const static core::Func DumpAppendFunc {
+        "dump_append", FunctionType::get(core::VoidType, {core::StrType, core::IntType, core::IntPtrType, core::StrType, core::IntType}, false)
+    };
+    const static core::Func DumpAppendIntFunc {
+        "dump_append_int", FunctionType::get(core::VoidType, {core::StrType, core::IntType, core::IntPtrType, core::IntType}, false)
     };
 
+    // A line buffer and its length on the stack of the current function for CreateWriteError,
+    // created in its entry block
+    const static uint64_t ErrorBufferSize = 1024;
+    struct ErrorBuffer {
+        Value* data;
+        Value* length;
+    };
+    static ErrorBuffer CreateErrorBuffer() {
+        auto data = core::Builder.CreateAlloca(ArrayType::get(core::CharType, ErrorBufferSize), nullptr, "error_buffer");
+        auto length = core::Builder.CreateAlloca(core::IntType, nullptr, "error_length");
+        return {core::Builder.CreateGEP(data, {core::GetInt(0), core::GetInt(0)}), length};
+    }
+
+    // Builds a line from format and values in buffer and writes it to stderr with write(2). The
+    // format is split here, and dump_append and dump_append_int only copy bytes and digits, so
+    // unlike stdio this may run in the signal handlers of trace and stats. Only %lld, %d and %.*s
+    // are understood. A line longer than the buffer is cut.
+    static void CreateWriteError(const ErrorBuffer& buffer, const std::string& format, ArrayRef<Value*> values) {
+        core::Func write = {
+                "write", FunctionType::get(core::IntType, {core::Builder.getInt32Ty(), core::StrType, core::IntType}, false)
+        };
+        auto size = core::GetInt(ErrorBufferSize);
+        auto append = [&](Value* str, Value* length) {
+            core::CallFunction(DumpAppendFunc, {buffer.data, size, buffer.length, str, length});
+        };
+        auto value = values.begin();
+        auto next = [&]() {
+            assert(value != values.end());
+            return core::Builder.CreateSExtOrTrunc(*value++, core::IntType);
+        };
+        core::Builder.CreateStore(core::GetInt(0), buffer.length);
+        std::string text;
+        auto flush = [&]() {
+            if (text.empty()) { return; }
+            append(core::Builder.CreateGlobalStringPtr(text), core::GetInt(text.size()));
+            text.clear();
+        };
+        for (size_t i = 0; i < format.size(); i++) {
+            if (format.compare(i, 4, "%lld") == 0 || format.compare(i, 2, "%d") == 0) {
+                flush();
+                core::CallFunction(DumpAppendIntFunc, {buffer.data, size, buffer.length, next()});
+                i += format[i + 1] == 'd' ? 1 : 3;
+            } else if (format.compare(i, 4, "%.*s") == 0) {
+                flush();
+                auto length = next();
+                append(*value++, length);
+                i += 3;
+            } else {
+                text += format[i];
+            }
+        }
+        flush();
+        assert(value == values.end());
+        core::CallFunction(write, {core::Builder.getInt32(2), buffer.data, core::Builder.CreateLoad(buffer.length)});
+    }
+
     static void Initialize() {
         core::Func printf = {
                 "printf", FunctionType::get(core::IntType, {core::StrType}, true)
@@ -55,14 +204,14 @@ namespace util {
         core::Func getchar = {
                 "getchar", FunctionType::get(core::CharType, {}, false)
         };
-        core::Func strtoll = {
-                "strtoll", FunctionType::get(core::IntType, {core::StrType, core::StrType->getPointerTo(), core::IntType}, false)
+        core::Func memcmp = {
+                "memcmp", FunctionType::get(core::Builder.getInt32Ty(), {core::StrType, core::StrType, core::IntType}, false)
         };
-        core::Func strcmp = {
-                "strcmp", FunctionType::get(core::IntType, {core::StrType, core::StrType}, false)
+        core::Func fwrite = {
+                "fwrite", FunctionType::get(core::IntType, {core::StrType, core::IntType, core::IntType, core::StrType}, false)
         };
-        core::Func strcpy = {
-                "strcpy", FunctionType::get(core::StrType, {core::StrType, core::StrType}, false)
+        core::Func memcpy = {
+                "memcpy", FunctionType::get(core::StrType, {core::StrType, core::StrType, core::IntType}, false)
         };
         core::CreateFunction(PrintCharFunc, [=](Function* f, BasicBlock* entry){
             auto arg = f->arg_begin();
@@ -70,9 +219,12 @@ namespace util {
             core::Builder.CreateRetVoid();
         });
         core::CreateFunction(PrintStrFunc, [=](Function* f, BasicBlock* entry){
-            auto arg = f->arg_begin();
-            auto fmt = core::Builder.CreateGlobalStringPtr("%s");
-            core::CallFunction(printf, {fmt, arg});
+            auto args = f->arg_begin();
+            auto str = args++;
+            auto length = args++;
+            // Not printf("%.*s"), which stops at the first NUL
+            auto stdout_file = core::Builder.CreateLoad(core::CreateGlobalVariable("stdout", core::StrType));
+            core::CallFunction(fwrite, {str, core::GetInt(1), length, stdout_file});
             core::Builder.CreateRetVoid();
         });
         core::CreateFunction(PrintIntFunc, [=](Function* f, BasicBlock* entry){
@@ -81,31 +233,85 @@ namespace util {
             core::CallFunction(printf, {fmt, arg});
             core::Builder.CreateRetVoid();
         });
+        core::CreateFunction(PrintFloatFunc, [=](Function* f, BasicBlock* entry){
+            auto arg = f->arg_begin();
+            auto fmt = core::Builder.CreateGlobalStringPtr("%g ");
+            core::CallFunction(printf, {fmt, arg});
+            core::Builder.CreateRetVoid();
+        });
         core::CreateFunction(StringToIntFunc, [=](Function* f, BasicBlock* entry){
-            auto str = f->arg_begin();
-            auto endptr = core::Builder.CreateAlloca(core::StrType);
-            auto base = core::GetInt(10);
-            auto number = core::CallFunction(strtoll, {str, endptr, base});
-            core::Builder.CreateRet(number);
+            auto args = f->arg_begin();
+            auto str = args++;
+            auto length = args++;
+            auto check_sign = core::CreateBasicBlock("check_sign", f);
+            auto loop = core::CreateBasicBlock("loop", f);
+            auto digit = core::CreateBasicBlock("digit", f);
+            auto accumulate = core::CreateBasicBlock("accumulate", f);
+            auto end = core::CreateBasicBlock("end", f);
+            auto is_empty = core::Builder.CreateICmpSLE(length, core::GetInt(0));
+            core::Builder.CreateCondBr(is_empty, end, check_sign);
+
+            core::Builder.SetInsertPoint(check_sign);
+            auto first = core::Builder.CreateLoad(str);
+            auto is_negative = core::Builder.CreateICmpEQ(first, core::GetChar('-'));
+            auto start = core::Builder.CreateIntCast(is_negative, core::IntType, false);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(loop);
+            auto index = core::Builder.CreatePHI(core::IntType, 2);
+            auto value = core::Builder.CreatePHI(core::IntType, 2);
+            index->addIncoming(start, check_sign);
+            value->addIncoming(core::GetInt(0), check_sign);
+            auto is_end = core::Builder.CreateICmpSGE(index, length);
+            core::Builder.CreateCondBr(is_end, end, digit);
+
+            core::Builder.SetInsertPoint(digit);
+            auto c = core::Builder.CreateLoad(core::Builder.CreateGEP(str, index));
+            auto d = core::Builder.CreateIntCast(core::Builder.CreateSub(c, core::GetChar('0')), core::IntType, false);
+            auto is_digit = core::Builder.CreateICmpULT(d, core::GetInt(10));
+            core::Builder.CreateCondBr(is_digit, accumulate, end);
+
+            core::Builder.SetInsertPoint(accumulate);
+            auto next_value = core::Builder.CreateAdd(core::Builder.CreateMul(value, core::GetInt(10)), d);
+            index->addIncoming(core::Builder.CreateAdd(index, core::GetInt(1)), accumulate);
+            value->addIncoming(next_value, accumulate);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(end);
+            auto result = core::Builder.CreatePHI(core::IntType, 3);
+            result->addIncoming(core::GetInt(0), entry);
+            result->addIncoming(value, loop);
+            result->addIncoming(value, digit);
+            auto sign = core::Builder.CreatePHI(core::BoolType, 3);
+            sign->addIncoming(core::GetBool(false), entry);
+            sign->addIncoming(is_negative, loop);
+            sign->addIncoming(is_negative, digit);
+            auto negated = core::Builder.CreateNeg(result);
+            core::Builder.CreateRet(core::Builder.CreateSelect(sign, negated, result));
         });
         core::CreateFunction(StringEqualFunc, [=](Function* f, BasicBlock* entry) {
             auto args = f->arg_begin();
             auto a_str = args++;
             auto b_str = args++;
-            auto cmp = core::CallFunction(strcmp, {a_str, b_str});
-            auto icmp = core::Builder.CreateICmpEQ(cmp, core::GetInt(0));
+            auto length = args++;
+            auto cmp = core::CallFunction(memcmp, {a_str, b_str, length});
+            auto icmp = core::Builder.CreateICmpEQ(cmp, core::Builder.getInt32(0));
             core::Builder.CreateRet(icmp);
         });
         core::CreateFunction(StringCopyFunc, [=](Function* f, BasicBlock* entry) {
             auto args = f->arg_begin();
-            auto a_str = args++;
-            auto b_str = args++;
-            core::CallFunction(strcpy, {a_str, b_str});
+            auto dst = args++;
+            auto src = args++;
+            auto length = args++;
+            core::CallFunction(memcpy, {dst, src, length});
             core::Builder.CreateRetVoid();
         });
         core::CreateFunction(FindXtFunc, [=](Function* f, BasicBlock* entry){
-            auto arg = f->arg_begin();
+            auto args = f->arg_begin();
+            auto str = args++;
+            auto length = args++;
             auto loop = core::CreateBasicBlock("loop", f);
+            auto check_length = core::CreateBasicBlock("check_length", f);
             auto check_word = core::CreateBasicBlock("check_word", f);
             auto loop_continue = core::CreateBasicBlock("loop_continue", f);
             auto end = core::CreateBasicBlock("end", f);
@@ -117,11 +323,16 @@ namespace util {
             auto xt = core::Builder.CreatePHI(dict::XtPtrType, 2);
             xt->addIncoming(last_xt, entry);
             auto is_null = core::Builder.CreateICmpEQ(core::Builder.CreatePtrToInt(xt, core::IntType), core::GetInt(0));
-            core::Builder.CreateCondBr(is_null, not_found, check_word);
+            core::Builder.CreateCondBr(is_null, not_found, check_length);
+
+            core::Builder.SetInsertPoint(check_length);
+            auto word_length = dict::GetXtWordLength(xt);
+            auto is_same_length = core::Builder.CreateICmpEQ(length, word_length);
+            core::Builder.CreateCondBr(is_same_length, check_word, loop_continue);
 
             core::Builder.SetInsertPoint(check_word);
             auto word = dict::GetXtWord(xt);
-            auto is_equal = core::CallFunction(StringEqualFunc, {arg, word});
+            auto is_equal = core::CallFunction(StringEqualFunc, {str, word, length});
             core::Builder.CreateCondBr(is_equal, end, loop_continue);
 
             core::Builder.SetInsertPoint(loop_continue);
@@ -135,6 +346,65 @@ namespace util {
             core::Builder.SetInsertPoint(not_found);
             core::Builder.CreateRet(dict::XtPtrNull);
         });
+        FindCache = core::CreateGlobalArrayVariable("find_cache", dict::XtPtrType, FindCacheSize, false);
+        core::CreateFunction(HashNameFunc, [=](Function* f, BasicBlock* entry){
+            auto args = f->arg_begin();
+            auto str = args++;
+            auto length = args++;
+            auto loop = core::CreateBasicBlock("loop", f);
+            auto end = core::CreateBasicBlock("end", f);
+            auto basis = core::GetIndex(2166136261);
+            auto is_empty = core::Builder.CreateICmpSLE(length, core::GetInt(0));
+            core::Builder.CreateCondBr(is_empty, end, loop);
+
+            core::Builder.SetInsertPoint(loop);
+            auto index = core::Builder.CreatePHI(core::IntType, 2);
+            auto hash = core::Builder.CreatePHI(core::IndexType, 2);
+            index->addIncoming(core::GetInt(0), entry);
+            hash->addIncoming(basis, entry);
+            auto c = core::Builder.CreateLoad(core::Builder.CreateGEP(str, index));
+            auto mixed = core::Builder.CreateXor(hash, core::Builder.CreateZExt(c, core::IndexType));
+            auto next_hash = core::Builder.CreateMul(mixed, core::GetIndex(16777619));
+            auto next_index = core::Builder.CreateAdd(index, core::GetInt(1));
+            index->addIncoming(next_index, loop);
+            hash->addIncoming(next_hash, loop);
+            core::Builder.CreateCondBr(core::Builder.CreateICmpSGE(next_index, length), end, loop);
+
+            core::Builder.SetInsertPoint(end);
+            auto result = core::Builder.CreatePHI(core::IndexType, 2);
+            result->addIncoming(basis, entry);
+            result->addIncoming(next_hash, loop);
+            core::Builder.CreateRet(core::Builder.CreateAnd(result, core::GetIndex(FindCacheSize - 1)));
+        });
+        core::CreateFunction(FindXtCachedFunc, [=](Function* f, BasicBlock* entry){
+            auto args = f->arg_begin();
+            auto str = args++;
+            auto length = args++;
+            auto check_length = core::CreateBasicBlock("check_length", f);
+            auto check_word = core::CreateBasicBlock("check_word", f);
+            auto hit = core::CreateBasicBlock("hit", f);
+            auto miss = core::CreateBasicBlock("miss", f);
+            auto hash = core::CallFunction(HashNameFunc, {str, length});
+            auto slot = core::Builder.CreateGEP(FindCache, {core::GetIndex(0), hash});
+            auto cached = core::Builder.CreateLoad(slot);
+            core::Builder.CreateCondBr(core::Builder.CreateIsNull(cached), miss, check_length);
+
+            core::Builder.SetInsertPoint(check_length);
+            auto is_same_length = core::Builder.CreateICmpEQ(length, dict::GetXtWordLength(cached));
+            core::Builder.CreateCondBr(is_same_length, check_word, miss);
+
+            core::Builder.SetInsertPoint(check_word);
+            auto is_equal = core::CallFunction(StringEqualFunc, {str, dict::GetXtWord(cached), length});
+            core::Builder.CreateCondBr(is_equal, hit, miss);
+
+            core::Builder.SetInsertPoint(hit);
+            core::Builder.CreateRet(cached);
+
+            core::Builder.SetInsertPoint(miss);
+            auto xt = core::CallFunction(FindXtFunc, {str, length});
+            core::Builder.CreateStore(core::Builder.CreateSelect(core::Builder.CreateIsNull(xt), cached, xt), slot);
+            core::Builder.CreateRet(xt);
+        });
         core::CreateFunction(PrintStackFunc, [](Function* f, BasicBlock* entry){
             auto args = f->arg_begin();
             auto current_index = args++;
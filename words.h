@@ -9,9 +9,17 @@
 #include "dict.h"
 #include "stack.h"
 #include "util.h"
+#include "kernel.h"
+#include "trace.h"
+#include "stats.h"
+#include "profile.h"
+#include "task.h"
+#include "cache.h"
+#include "budget.h"
 
 namespace words {
     static dict::Word Lit;
+    static dict::Word WideLit;
     static dict::Word Branch;
     static dict::Word Skip;
     static dict::Word Branch0;
@@ -31,6 +39,11 @@ namespace words {
     static dict::Word Exit;
     static dict::Word State;
     static dict::Word Comma;
+    static dict::Word CompileComma;
+    static dict::Word Type;
+    static dict::Word Flit;
+    static dict::Word TaskEnd;
+    static dict::Word Execute;
 
     static Constant* StateValue;
     static Constant* InputBuffer;
@@ -39,37 +52,128 @@ namespace words {
         return ConstantExpr::getIntToPtr(ConstantInt::get(core::IntType, num), dict::XtPtrType);
     }
 
+    static Constant* GetConstantFloatToXtPtr(double num) {
+        auto bits = ConstantExpr::getBitCast(core::GetFloat(num), core::IntType);
+        return ConstantExpr::getIntToPtr(bits, dict::XtPtrType);
+    }
+
     static Constant* GetConstantStrToXtPtr(const std::string& str) {
         auto ptr = core::Builder.CreateGlobalStringPtr(str);
         return ConstantExpr::getPointerCast(ptr, dict::XtPtrType);
     }
 
     static void CreateBrNext() {
-        core::Builder.CreateBr(engine::Next);
+        engine::CreateBrNext();
     };
 
     static void CreateRet(int ret) {
         core::Builder.CreateRet(core::GetInt(ret));
     };
 
+    // Compiles lit or wlit with value at here and continues in the block name_end
+    static void CreateLiteral(const std::string& name, Value* value) {
+        if (!dict::Tokens) {
+            dict::Append(dict::GetXtCell(Lit.xt), dict::XtCell);
+            dict::Append(dict::CreateWideCell(value), dict::RawCell);
+            return;
+        }
+        auto narrow = core::CreateBasicBlock(name + "_narrow", engine::MainFunction);
+        auto wide = core::CreateBasicBlock(name + "_wide", engine::MainFunction);
+        auto end = core::CreateBasicBlock(name + "_end", engine::MainFunction);
+        auto cell = core::Builder.CreateTrunc(value, core::IndexType);
+        auto is_narrow = core::Builder.CreateICmpEQ(core::Builder.CreateSExt(cell, core::IntType), value);
+        core::Builder.CreateCondBr(is_narrow, narrow, wide);
+
+        core::Builder.SetInsertPoint(narrow);
+        dict::Append(dict::GetXtCell(Lit.xt), dict::XtCell);
+        dict::Append(cell, dict::RawCell);
+        core::Builder.CreateBr(end);
+
+        core::Builder.SetInsertPoint(wide);
+        dict::AppendWide(value, dict::RawCell, WideLit.xt);
+        core::Builder.CreateBr(end);
+
+        core::Builder.SetInsertPoint(end);
+    };
+
+    // Compiles a call of xt, or a copy of its body when it is marked inline, and continues in the block name_end
+    static void CreateCompile(const std::string& name, Value* xt) {
+        auto call = core::CreateBasicBlock(name + "_call", engine::MainFunction);
+        auto copy = core::CreateBasicBlock(name + "_copy", engine::MainFunction);
+        auto end = core::CreateBasicBlock(name + "_end", engine::MainFunction);
+        auto cells = dict::GetXtInline(xt);
+        core::Builder.CreateCondBr(core::Builder.CreateICmpEQ(cells, core::GetIndex(0)), call, copy);
+
+        core::Builder.SetInsertPoint(call);
+        dict::Append(dict::CreateXtCell(xt), dict::XtCell);
+        core::Builder.CreateBr(end);
+
+        core::Builder.SetInsertPoint(copy);
+        auto here = core::Builder.CreateLoad(dict::HereValue);
+        auto colon = core::Builder.CreateIntCast(dict::GetXtColon(xt), core::IntType, false);
+        auto start = core::Builder.CreateIntCast(here, core::IntType, false);
+        auto length = core::Builder.CreateIntCast(cells, core::IntType, false);
+        kernel::CreateLoop(engine::MainFunction, name + "_cells", core::GetInt(0), length, 1, {}, [=](Value* i, const kernel::Values&) -> kernel::Values {
+            auto from = core::Builder.CreateGEP(dict::Memory, {core::GetInt(0), core::Builder.CreateAdd(colon, i)});
+            auto to = core::Builder.CreateGEP(dict::Memory, {core::GetInt(0), core::Builder.CreateAdd(start, i)});
+            core::Builder.CreateStore(core::Builder.CreateLoad(from), to);
+            auto from_kind = core::Builder.CreateGEP(dict::Kinds, {core::GetInt(0), core::Builder.CreateAdd(colon, i)});
+            auto to_kind = core::Builder.CreateGEP(dict::Kinds, {core::GetInt(0), core::Builder.CreateAdd(start, i)});
+            core::Builder.CreateStore(core::Builder.CreateLoad(from_kind), to_kind);
+            return {};
+        });
+        core::Builder.CreateStore(core::Builder.CreateAdd(here, cells), dict::HereValue);
+        core::Builder.CreateBr(end);
+
+        core::Builder.SetInsertPoint(end);
+    };
+
+    // Copies length bytes at str to the string space, where they live as long as the dictionary
+    static Value* CreateString(Value* str, Value* length) {
+        auto here = core::Builder.CreateLoad(dict::StringsHere);
+        auto is_full = core::Builder.CreateICmpUGT(length, core::Builder.CreateSub(core::GetInt(dict::StringsSize), here));
+        dict::CreateOverflowCheck("strings", is_full);
+        auto copy = core::Builder.CreateGEP(dict::Strings, {core::GetIndex(0), here});
+        core::CallFunction(util::StringCopyFunc, {copy, str, length});
+        core::Builder.CreateStore(core::Builder.CreateAdd(here, length), dict::StringsHere);
+        return copy;
+    }
+
     static void Initialize(Function* main, BasicBlock* entry) {
         StateValue = core::CreateGlobalVariable("state", core::IntType, core::GetInt(0), false);
         InputBuffer = core::CreateGlobalArrayVariable("input_buffer", core::CharType, 1024, false);
 
         auto args = main->arg_begin();
-        auto argc = args++;
-        auto argv = args++;
-        auto reader = core::CallFunction(util::CreateReaderFunc, {argc, argv});
+        Value* reader = args;
+        if (!engine::Embed) {
+            auto argc = args++;
+            auto argv = args++;
+            reader = core::CallFunction(util::CreateReaderFunc, {argc, argv});
+        }
+        auto ior = core::Builder.CreateAlloca(core::IntType, nullptr, "ior");
+        auto flag = core::Builder.CreateAlloca(core::IntType, nullptr, "flag");
+        auto size = core::Builder.CreateAlloca(core::IntType, nullptr, "size");
+        auto read_fd = core::Builder.CreateAlloca(core::IntType, nullptr, "read_fd");
+        auto write_fd = core::Builder.CreateAlloca(core::IntType, nullptr, "write_fd");
+        auto events = core::Builder.CreateAlloca(core::IntType, nullptr, "events");
 
         util::Initialize();
+        kernel::Initialize(dict::DataAlign);
 
         dict::AddNativeWord("bye", [=](){
-            core::CallFunction(util::DestroyReaderFunc, reader);
+            // The host owns the reader of an embedded VM
+            if (!engine::Embed) { core::CallFunction(util::DestroyReaderFunc, reader); }
+            if (stats::Enabled) { core::CallFunction(stats::ExitFunc); }
+            if (profile::Generate) { core::CallFunction(profile::WriteFunc); }
             CreateRet(0);
         });
         Throw = dict::AddNativeWord("throw", [](){
+            if (trace::Enabled) { core::CallFunction(trace::DumpFunc); }
             core::Builder.CreateRet(stack::Pop());
         });
+        core::Builder.SetInsertPoint(dict::OverflowBlock);
+        stack::Push(core::GetInt(-8));
+        core::Builder.CreateBr(Throw.block);
         dict::AddNativeWord("emit", [](){
             auto value = stack::Pop();
             core::CallFunction(util::PrintCharFunc, value);
@@ -181,18 +285,31 @@ namespace words {
         Lit = dict::AddNativeWord("lit", [](){
             auto pc = core::Builder.CreateLoad(engine::PC);
             auto value = core::Builder.CreateLoad(pc);
-            stack::PushPtr(value);
+            if (dict::Tokens) {
+                stack::Push(core::Builder.CreateSExt(value, core::IntType));
+            } else {
+                stack::PushPtr(value);
+            }
             auto new_pc = core::Builder.CreateGEP(pc, core::GetIndex(1));
             core::Builder.CreateStore(new_pc, engine::PC);
             CreateBrNext();
         });
+        dict::Operands[Lit.xt] = dict::LiteralOperand;
+        if (dict::Tokens) {
+            WideLit = dict::AddNativeWord("wlit", [](){
+                auto pc = core::Builder.CreateLoad(engine::PC);
+                stack::Push(dict::GetWideValue(core::Builder.CreateLoad(pc)));
+                auto new_pc = core::Builder.CreateGEP(pc, core::GetIndex(1));
+                core::Builder.CreateStore(new_pc, engine::PC);
+                CreateBrNext();
+            });
+            dict::WideLitXt = WideLit.xt;
+        }
         Branch = dict::AddNativeWord("branch", [](){
             auto pc = core::Builder.CreateLoad(engine::PC);
-            auto value = core::Builder.CreateLoad(pc);
-            auto offset = core::Builder.CreatePtrToInt(value, core::IndexType);
-            auto new_pc = core::Builder.CreateGEP(dict::Memory, {core::GetIndex(0), offset});
+            auto new_pc = dict::DecodeTarget(pc);
             core::Builder.CreateStore(new_pc, engine::PC);
-            CreateBrNext();
+            budget::CreateCheck("i_branch", budget::Enabled ? core::Builder.CreateICmpULE(new_pc, pc) : nullptr);
         });
         Skip = dict::AddNativeWord("skip", [](){
             auto pc = core::Builder.CreateLoad(engine::PC);
@@ -202,7 +319,8 @@ namespace words {
         });
         Branch0 = dict::AddNativeWord("0branch", [](){
             auto is_zero = core::Builder.CreateICmpEQ(stack::Pop(), core::GetInt(0));
-            core::Builder.CreateCondBr(is_zero, Branch.block, Skip.block);
+            if (profile::Generate) { profile::RecordBranch(is_zero); }
+            profile::Branch0 = core::Builder.CreateCondBr(is_zero, Branch.block, Skip.block);
         });
         State = dict::AddNativeWord("state", [](){
             auto addr = ConstantExpr::getPtrToInt(StateValue, core::IntType);
@@ -211,13 +329,13 @@ namespace words {
         });
         Fetch = dict::AddNativeWord("@", [](){
             auto addr = stack::PopPtr(core::IntPtrType);
-            stack::Push(core::Builder.CreateLoad(addr));
+            stack::Push(core::Builder.CreateAlignedLoad(addr, dict::DataAlign));
             CreateBrNext();
         });
         Write = dict::AddNativeWord("!", [](){
             auto addr = stack::PopPtr(core::IntPtrType);
             auto value = stack::Pop();
-            core::Builder.CreateStore(value, addr);
+            core::Builder.CreateAlignedStore(value, addr, dict::DataAlign);
             CreateBrNext();
         });
         Here = dict::AddNativeWord("here", [](){
@@ -231,7 +349,7 @@ namespace words {
             CreateBrNext();
         });
         dict::AddNativeWord(">r", [](){
-            stack::RPush(stack::PopPtr(dict::XtPtrPtrType));
+            stack::RPush(stack::PopPtr(dict::CodePtrType));
             CreateBrNext();
         });
         dict::AddNativeWord("r>", [](){
@@ -244,8 +362,8 @@ namespace words {
             CreateBrNext();
         });
         dict::AddNativeWord("2>r", [](){
-            auto first = stack::PopPtr(dict::XtPtrPtrType);
-            auto second = stack::PopPtr(dict::XtPtrPtrType);
+            auto first = stack::PopPtr(dict::CodePtrType);
+            auto second = stack::PopPtr(dict::CodePtrType);
             stack::RPush(second);
             stack::RPush(first);
             CreateBrNext();
@@ -270,8 +388,9 @@ namespace words {
             auto index = dict::GetXtColon();
             auto new_pc = core::Builder.CreateGEP(dict::Memory, {core::GetIndex(0), index});
             core::Builder.CreateStore(new_pc, engine::PC);
-            CreateBrNext();
+            budget::CreateCheck("i_docol");
         });
+        cache::Docol = Docol.addr;
         Exit = dict::AddNativeWord("exit", [](){
             auto return_pc = stack::RPop();
             core::Builder.CreateStore(return_pc, engine::PC);
@@ -292,51 +411,83 @@ namespace words {
             auto buf = stack::PopPtr(core::StrType);
             //auto res = core::CallFunction(util::ReadWordFunc, {buf, core::GetInt(1024)});
             auto res = core::CallFunction(util::ReadWordFromReaderFunc, {reader, buf, core::GetInt(1024)});
+            if (stats::Enabled) { stats::RecordToken(res); }
             stack::Push(res);
             auto is_failed = core::Builder.CreateICmpSLT(res, core::GetInt(0));
             core::Builder.CreateCondBr(is_failed, Throw.block, engine::Next);
         });
-        dict::AddNativeWord("prints", [](){
+        // ( addr len -- ) makes word read the string until its end, then the current input again
+        dict::AddNativeWord("(evaluate)", [=](){
+            auto length = stack::Pop();
+            auto str = stack::PopPtr(core::StrType);
+            core::CallFunction(util::ReaderEvaluateFunc, {reader, str, length});
+            CreateBrNext();
+        });
+        // ( addr len -- flag ) loads the file named by addr len from its include cache, or makes word
+        // read it and returns true, so that include interprets it and (include-end) caches the result
+        dict::AddNativeWord("(include)", [=](){
+            auto length = stack::Pop();
+            auto name = stack::PopPtr(core::StrType);
+            auto res = core::CallFunction(cache::BeginFunc, {reader, cache::GetImage(), name, length});
+            stack::Push(res);
+            auto is_failed = core::Builder.CreateICmpSGT(res, core::GetInt(0));
+            core::Builder.CreateCondBr(is_failed, Throw.block, engine::Next);
+        });
+        dict::AddNativeWord("(include-end)", [](){
+            core::CallFunction(cache::EndFunc, {cache::GetImage()});
+            CreateBrNext();
+        });
+        Type = dict::AddNativeWord("type", [](){
+            auto length = stack::Pop();
             auto str = stack::PopPtr(core::StrType);
-            core::CallFunction(util::PrintStrFunc, str);
+            core::CallFunction(util::PrintStrFunc, {str, length});
             CreateBrNext();
         });
         dict::AddNativeWord("number", [](){
+            auto length = stack::Pop();
             auto str = stack::PopPtr(core::StrType);
-            stack::Push(core::CallFunction(util::StringToIntFunc, str));
+            stack::Push(core::CallFunction(util::StringToIntFunc, {str, length}));
             CreateBrNext();
         });
         dict::AddNativeWord("find", [](){
+            auto length = stack::Pop();
             auto str = stack::PopPtr(core::StrType);
-            auto found = core::CallFunction(util::FindXtFunc, str);
+            auto found = core::CallFunction(util::FindXtCachedFunc, {str, length});
             stack::PushPtr(found);
             CreateBrNext();
         });
         dict::AddNativeWord("cr", [](){
-            auto cr = core::Builder.CreateGlobalStringPtr("\n");
-            core::CallFunction(util::PrintStrFunc, cr);
+            core::CallFunction(util::PrintCharFunc, core::GetInt('\n'));
             CreateBrNext();
         });
         dict::AddNativeWord("strcpy", [](){
             auto src = stack::PopPtr(core::StrType);
             auto length = stack::Pop();
             auto dst = core::Builder.CreateAlloca(core::CharType, length);
-            core::CallFunction(util::StringCopyFunc, {dst, src});
+            core::CallFunction(util::StringCopyFunc, {dst, src, length});
             stack::PushPtr(dst);
             CreateBrNext();
         });
         Create = dict::AddNativeWord("create", [](){
-            auto xt = core::Builder.CreateAlloca(dict::XtType);
+            auto index = core::Builder.CreateLoad(dict::WordCount);
+            dict::CreateOverflowCheck("i_create_words", core::Builder.CreateICmpUGE(index, core::GetIndex(dict::MaxWords)));
+            auto xt = core::Builder.CreateGEP(dict::Xts, {core::GetIndex(0), index});
+            auto header = core::Builder.CreateGEP(dict::Headers, {core::GetIndex(0), index});
             auto name = stack::PopPtr(core::StrType);
             auto length = stack::Pop();
-            auto word = core::Builder.CreateAlloca(core::CharType, length);
+            auto word = CreateString(name, length);
             auto here = core::Builder.CreateLoad(dict::HereValue);
-            core::CallFunction(util::StringCopyFunc, {word, name});
-            core::Builder.CreateStore(dict::GetLastXt(),    core::Builder.CreateGEP(xt, {core::GetIndex(0), core::GetIndex(dict::XtPrevious)}));
-            core::Builder.CreateStore(word,                 core::Builder.CreateGEP(xt, {core::GetIndex(0), core::GetIndex(dict::XtWord)}));
+            if (stats::Enabled) { stats::RecordWord(length); }
+            auto hash = core::CallFunction(util::HashNameFunc, {word, length});
+            core::Builder.CreateStore(xt, core::Builder.CreateGEP(util::FindCache, {core::GetIndex(0), hash}));
+            core::Builder.CreateStore(dict::GetLastXt(),    core::Builder.CreateGEP(header, {core::GetIndex(0), core::GetIndex(dict::XtPrevious)}));
+            core::Builder.CreateStore(word,                 core::Builder.CreateGEP(header, {core::GetIndex(0), core::GetIndex(dict::XtWord)}));
+            core::Builder.CreateStore(length,               core::Builder.CreateGEP(header, {core::GetIndex(0), core::GetIndex(dict::XtWordLength)}));
+            core::Builder.CreateStore(core::GetBool(false), core::Builder.CreateGEP(header, {core::GetIndex(0), core::GetIndex(dict::XtImmediate)}));
+            core::Builder.CreateStore(core::GetIndex(0),    core::Builder.CreateGEP(header, {core::GetIndex(0), core::GetIndex(dict::XtInline)}));
             core::Builder.CreateStore(Docol.addr,           core::Builder.CreateGEP(xt, {core::GetIndex(0), core::GetIndex(dict::XtImplAddress)}));
-            core::Builder.CreateStore(core::GetBool(false), core::Builder.CreateGEP(xt, {core::GetIndex(0), core::GetIndex(dict::XtImmediate)}));
             core::Builder.CreateStore(here,                 core::Builder.CreateGEP(xt, {core::GetIndex(0), core::GetIndex(dict::XtColon)}));
+            core::Builder.CreateStore(core::Builder.CreateAdd(index, core::GetIndex(1)), dict::WordCount);
             core::Builder.CreateStore(xt, dict::LastXt);
             CreateBrNext();
         });
@@ -346,20 +497,548 @@ namespace words {
             stack::Push(core::Builder.CreateIntCast(flag, core::IntType, true));
             CreateBrNext();
         });
+        // Data, such as the cells of a vector. Code goes through compile, literal and branch,
         Comma = dict::AddNativeWord(",", [](){
+            dict::Append(stack::Pop(), dict::RawCell, dict::DataCells);
+            CreateBrNext();
+        });
+        CompileComma = dict::AddNativeWord("compile,", [](){
+            CreateCompile("i_compile_comma", stack::PopPtr(dict::XtPtrType));
+            CreateBrNext();
+        });
+        // Marks the last word to be copied by compile, instead of called. Its body must be straight
+        // code which does not use the return stack; everything but the final exit is copied.
+        dict::AddNativeWord("inline", [](){
+            auto xt = dict::GetLastXt();
+            auto here = core::Builder.CreateLoad(dict::HereValue);
+            auto cells = core::Builder.CreateSub(core::Builder.CreateSub(here, dict::GetXtColon(xt)), core::GetIndex(1));
+            core::Builder.CreateStore(cells, core::Builder.CreateGEP(dict::GetHeader(xt), {core::GetIndex(0), core::GetIndex(dict::XtInline)}));
+            CreateBrNext();
+        });
+        // ( -- pool strings words here ) the state of the dictionary, which marker compiles into its word
+        dict::AddNativeWord("(marker)", [](){
+            stack::Push(dict::Tokens ? core::Builder.CreateZExt(core::Builder.CreateLoad(dict::PoolCount), core::IntType) : core::GetInt(0));
+            stack::Push(core::Builder.CreateLoad(dict::StringsHere));
+            stack::Push(core::Builder.CreateZExt(core::Builder.CreateLoad(dict::WordCount), core::IntType));
+            stack::Push(core::Builder.CreateZExt(core::Builder.CreateLoad(dict::HereValue), core::IntType));
+            CreateBrNext();
+        });
+        // ( xt -- here words strings pool ) the state of the dictionary before xt was created
+        dict::AddNativeWord("(forget-state)", [](){
+            auto failed = core::CreateBasicBlock("i_forget_state_failed", engine::MainFunction);
+            auto ok = core::CreateBasicBlock("i_forget_state_ok", engine::MainFunction);
             auto xt = stack::PopPtr(dict::XtPtrType);
+            auto index = dict::GetXtIndex(xt);
+            auto fence = core::Builder.CreateZExt(core::Builder.CreateLoad(dict::Fence), core::IntType);
+            auto is_null = core::Builder.CreateIsNull(xt);
+            auto is_fenced = core::Builder.CreateICmpSLT(index, fence);
+            core::Builder.CreateCondBr(core::Builder.CreateOr(is_null, is_fenced), failed, ok);
+
+            core::Builder.SetInsertPoint(failed);
+            stack::Push(core::Builder.CreateSelect(is_null, core::GetInt(-13), core::GetInt(-15)));
+            core::Builder.CreateBr(Throw.block);
+
+            core::Builder.SetInsertPoint(ok);
+            auto colon = core::Builder.CreateZExt(dict::GetXtColon(xt), core::IntType);
+            auto name = core::Builder.CreatePtrToInt(dict::GetXtWord(xt), core::IntType);
+            auto strings = core::Builder.CreatePtrToInt(core::CreateConstantGEP(dict::Strings), core::IntType);
+            stack::Push(colon);
+            stack::Push(index);
+            stack::Push(core::Builder.CreateSub(name, strings));
+            if (!dict::Tokens) {
+                stack::Push(core::GetInt(0));
+                CreateBrNext();
+                return;
+            }
+            // Pool entries are taken in the order of the cells indexing them, so the first one after colon is the oldest
+            auto here = core::Builder.CreateZExt(core::Builder.CreateLoad(dict::HereValue), core::IntType);
+            auto count = core::Builder.CreateZExt(core::Builder.CreateLoad(dict::PoolCount), core::IntType);
+            auto scan = kernel::CreateLoop(engine::MainFunction, "i_forget_state_pool", colon, here, 1, {count},
+                                           [](Value* i, const kernel::Values& pool) -> kernel::Values {
+                auto kind = core::Builder.CreateLoad(core::Builder.CreateGEP(dict::Kinds, {core::GetInt(0), i}));
+                auto cell = core::Builder.CreateLoad(core::Builder.CreateGEP(dict::Memory, {core::GetInt(0), i}));
+                auto entry = core::Builder.CreateZExt(cell, core::IntType);
+                auto is_pool = core::Builder.CreateICmpEQ(kind, dict::GetKind(dict::PoolCell));
+                auto is_older = core::Builder.CreateAnd(is_pool, core::Builder.CreateICmpULT(entry, pool[0]));
+                return {core::Builder.CreateSelect(is_older, entry, pool[0])};
+            });
+            stack::Push(scan.second[0]);
+            CreateBrNext();
+        });
+        // ( here words strings pool -- ) drops the words from index words on, with the code, names,
+        // strings and literal pool entries allocated after them, and forgets every cached lookup
+        dict::AddNativeWord("(forget)", [](){
+            auto pool = stack::Pop();
+            auto strings = stack::Pop();
+            auto words = core::Builder.CreateTrunc(stack::Pop(), core::IndexType);
+            auto here = core::Builder.CreateTrunc(stack::Pop(), core::IndexType);
+            auto xt = core::Builder.CreateGEP(dict::Xts, {core::GetIndex(0), words});
+            core::Builder.CreateStore(dict::GetXtPrevious(xt), dict::LastXt);
+            core::Builder.CreateStore(words, dict::WordCount);
+            core::Builder.CreateStore(here, dict::HereValue);
+            core::Builder.CreateStore(strings, dict::StringsHere);
+            if (dict::Tokens) { core::Builder.CreateStore(core::Builder.CreateTrunc(pool, core::IndexType), dict::PoolCount); }
+            kernel::CreateLoop(engine::MainFunction, "i_forget_cache", core::GetInt(0), core::GetInt(util::FindCacheSize), 1, {},
+                               [](Value* i, const kernel::Values&) -> kernel::Values {
+                core::Builder.CreateStore(dict::XtPtrNull, core::Builder.CreateGEP(util::FindCache, {core::GetInt(0), i}));
+                return {};
+            });
+            CreateBrNext();
+        });
+        dict::AddNativeWord("literal", [](){
+            CreateLiteral("i_literal", stack::Pop());
+            CreateBrNext();
+        });
+        // ( addr len -- ) compiles a copy of the string in the string space, pushed as addr len when run
+        dict::AddNativeWord("sliteral", [](){
+            auto length = stack::Pop();
+            auto str = CreateString(stack::PopPtr(core::StrType), length);
+            dict::AppendWide(core::Builder.CreatePtrToInt(str, core::IntType), dict::StringCell, dict::Tokens ? WideLit.xt : Lit.xt);
+            CreateLiteral("i_sliteral", length);
+            CreateBrNext();
+        });
+        // ( target -- ) compiles the operand of a branch to the cell index target
+        dict::AddNativeWord("branch,", [](){
+            auto target = core::Builder.CreateTrunc(stack::Pop(), core::IndexType);
             auto here = core::Builder.CreateLoad(dict::HereValue);
-            auto here_memory = core::Builder.CreateGEP(dict::Memory, {core::GetIndex(0), here});
-            core::Builder.CreateStore(xt, here_memory);
-            auto next = core::Builder.CreateAdd(here, core::GetIndex(1));
-            core::Builder.CreateStore(next, dict::HereValue);
+            dict::Append(dict::CreateTargetCell(target, here), dict::TargetCell);
+            CreateBrNext();
+        });
+        // ( target addr -- ) resolves the branch operand at addr, left by here@ before branch,
+        dict::AddNativeWord("branch!", [](){
+            auto addr = stack::PopPtr(dict::CodePtrType);
+            auto target = core::Builder.CreateTrunc(stack::Pop(), core::IndexType);
+            auto index = core::Builder.CreatePtrDiff(addr, core::CreateConstantGEP(dict::Memory));
+            auto cell = dict::CreateTargetCell(target, core::Builder.CreateTrunc(index, core::IndexType));
+            core::Builder.CreateStore(cell, addr);
+            CreateBrNext();
+        });
+        Flit = dict::AddNativeWord("flit", [](){
+            auto pc = core::Builder.CreateLoad(engine::PC);
+            auto value = dict::GetWideValue(core::Builder.CreateLoad(pc));
+            stack::FPush(core::Builder.CreateBitCast(value, core::FloatType));
+            auto new_pc = core::Builder.CreateGEP(pc, core::GetIndex(1));
+            core::Builder.CreateStore(new_pc, engine::PC);
+            CreateBrNext();
+        });
+        dict::Operands[Flit.xt] = dict::FloatOperand;
+        dict::AddNativeWord("fliteral", [](){
+            auto bits = core::Builder.CreateBitCast(stack::FPop(), core::IntType);
+            dict::AppendWide(bits, dict::RawCell, Flit.xt);
+            CreateBrNext();
+        });
+        dict::AddNativeWord(">float", [=](){
+            auto length = stack::Pop();
+            auto str = stack::PopPtr(core::StrType);
+            auto value = core::CallFunction(util::StringToFloatFunc, {str, length, flag});
+            auto ok = core::Builder.CreateLoad(flag);
+            auto push = core::CreateBasicBlock("i_>float_push", engine::MainFunction);
+            auto end = core::CreateBasicBlock("i_>float_end", engine::MainFunction);
+            core::Builder.CreateCondBr(core::Builder.CreateICmpNE(ok, core::GetInt(0)), push, end);
+
+            core::Builder.SetInsertPoint(push);
+            stack::FPush(value);
+            core::Builder.CreateBr(end);
+
+            core::Builder.SetInsertPoint(end);
+            stack::Push(ok);
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f+", [](){
+            auto right = stack::FPop();
+            auto left = stack::FPop();
+            stack::FPush(core::Builder.CreateFAdd(left, right));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f-", [](){
+            auto right = stack::FPop();
+            auto left = stack::FPop();
+            stack::FPush(core::Builder.CreateFSub(left, right));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f*", [](){
+            auto right = stack::FPop();
+            auto left = stack::FPop();
+            stack::FPush(core::Builder.CreateFMul(left, right));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f/", [](){
+            auto right = stack::FPop();
+            auto left = stack::FPop();
+            stack::FPush(core::Builder.CreateFDiv(left, right));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fsqrt", [](){
+            auto value = stack::FPop();
+            stack::FPush(core::CallIntrinsic(Intrinsic::sqrt, {core::FloatType}, {value}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f@", [](){
+            auto addr = stack::PopPtr(core::FloatPtrType);
+            stack::FPush(core::Builder.CreateAlignedLoad(addr, dict::DataAlign));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f!", [](){
+            auto addr = stack::PopPtr(core::FloatPtrType);
+            core::Builder.CreateAlignedStore(stack::FPop(), addr, dict::DataAlign);
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f.", [](){
+            core::CallFunction(util::PrintFloatFunc, stack::FPop());
+            CreateBrNext();
+        });
+        dict::AddNativeWord("s>f", [](){
+            stack::FPush(core::Builder.CreateSIToFP(stack::Pop(), core::FloatType));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("f>s", [](){
+            stack::Push(core::Builder.CreateFPToSI(stack::FPop(), core::IntType));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fdup", [](){
+            stack::FDup();
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fdrop", [](){
+            stack::FDrop();
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fswap", [](){
+            auto first = stack::FPop();
+            auto second = stack::FPop();
+            stack::FPush(first);
+            stack::FPush(second);
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vsum", [](){
+            auto n = stack::Pop();
+            auto addr = stack::PopPtr(core::IntPtrType);
+            stack::Push(core::CallFunction(kernel::SumFunc, {addr, n}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vdot", [](){
+            auto n = stack::Pop();
+            auto b = stack::PopPtr(core::IntPtrType);
+            auto a = stack::PopPtr(core::IntPtrType);
+            stack::Push(core::CallFunction(kernel::DotFunc, {a, b, n}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vmin", [](){
+            auto n = stack::Pop();
+            auto addr = stack::PopPtr(core::IntPtrType);
+            stack::Push(core::CallFunction(kernel::MinFunc, {addr, n}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vmax", [](){
+            auto n = stack::Pop();
+            auto addr = stack::PopPtr(core::IntPtrType);
+            stack::Push(core::CallFunction(kernel::MaxFunc, {addr, n}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vadd", [](){
+            auto n = stack::Pop();
+            auto dst = stack::PopPtr(core::IntPtrType);
+            auto b = stack::PopPtr(core::IntPtrType);
+            auto a = stack::PopPtr(core::IntPtrType);
+            core::CallFunction(kernel::AddFunc, {a, b, dst, n});
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vscale", [](){
+            auto k = stack::Pop();
+            auto n = stack::Pop();
+            auto addr = stack::PopPtr(core::IntPtrType);
+            core::CallFunction(kernel::ScaleFunc, {addr, n, k});
+            CreateBrNext();
+        });
+        dict::AddNativeWord("vscan", [](){
+            auto n = stack::Pop();
+            auto addr = stack::PopPtr(core::IntPtrType);
+            core::CallFunction(kernel::ScanFunc, {addr, n});
+            CreateBrNext();
+        });
+        dict::AddNativeWord("utime", [](){
+            stack::Push(core::CallFunction(util::UtimeFunc));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("r/o", [](){
+            stack::Push(core::GetInt(0));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("w/o", [](){
+            stack::Push(core::GetInt(1));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("r/w", [](){
+            stack::Push(core::GetInt(2));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("open-file", [=](){
+            auto fam = stack::Pop();
+            auto length = stack::Pop();
+            auto name = stack::PopPtr(core::StrType);
+            auto file = core::CallFunction(util::OpenFileFunc, {name, length, fam, ior});
+            stack::PushPtr(file);
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("create-file", [=](){
+            auto fam = stack::Pop();
+            auto length = stack::Pop();
+            auto name = stack::PopPtr(core::StrType);
+            auto file = core::CallFunction(util::CreateFileFunc, {name, length, fam, ior});
+            stack::PushPtr(file);
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("close-file", [](){
+            auto file = stack::PopPtr(core::PtrType);
+            stack::Push(core::CallFunction(util::CloseFileFunc, file));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("read-file", [=](){
+            auto file = stack::PopPtr(core::PtrType);
+            auto length = stack::Pop();
+            auto buf = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::ReadFileFunc, {file, buf, length, ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("read-line", [=](){
+            auto file = stack::PopPtr(core::PtrType);
+            auto length = stack::Pop();
+            auto buf = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::ReadLineFunc, {file, buf, length, flag, ior}));
+            stack::Push(core::Builder.CreateLoad(flag));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("write-file", [](){
+            auto file = stack::PopPtr(core::PtrType);
+            auto length = stack::Pop();
+            auto buf = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::WriteFileFunc, {file, buf, length}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("map-file", [=](){
+            auto length = stack::Pop();
+            auto name = stack::PopPtr(core::StrType);
+            auto addr = core::CallFunction(util::MapFileFunc, {name, length, size, ior});
+            stack::PushPtr(addr);
+            stack::Push(core::Builder.CreateLoad(size));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("unmap-file", [](){
+            auto length = stack::Pop();
+            auto addr = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::UnmapFileFunc, {addr, length}));
+            CreateBrNext();
+        });
+        if (trace::Enabled) {
+            dict::AddNativeWord(".trace", [](){
+                core::CallFunction(trace::DumpFunc);
+                CreateBrNext();
+            });
+        }
+        if (stats::Enabled) {
+            dict::AddNativeWord(".stats", [](){
+                core::CallFunction(stats::PrintFunc);
+                CreateBrNext();
+            });
+        }
+        dict::AddNativeWord("readable", [](){
+            stack::Push(core::GetInt(1));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("writable", [](){
+            stack::Push(core::GetInt(2));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("would-block", [](){
+            stack::Push(core::CallFunction(util::WouldBlockFunc));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fd-nonblock", [](){
+            stack::Push(core::CallFunction(util::FdNonblockFunc, {stack::Pop()}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fd-read", [=](){
+            auto file = stack::Pop();
+            auto length = stack::Pop();
+            auto buf = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::FdReadFunc, {file, buf, length, ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
             CreateBrNext();
         });
-        dict::AddNativeWord("execute", [](){ // This definition must be the last
+        dict::AddNativeWord("fd-write", [=](){
+            auto file = stack::Pop();
+            auto length = stack::Pop();
+            auto buf = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::FdWriteFunc, {file, buf, length, ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("fd-close", [](){
+            stack::Push(core::CallFunction(util::FdCloseFunc, {stack::Pop()}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("pipe", [=](){
+            auto result = core::CallFunction(util::FdPipeFunc, {read_fd, write_fd});
+            stack::Push(core::Builder.CreateLoad(read_fd));
+            stack::Push(core::Builder.CreateLoad(write_fd));
+            stack::Push(result);
+            CreateBrNext();
+        });
+        dict::AddNativeWord("unix-connect", [=](){
+            auto length = stack::Pop();
+            auto name = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::UnixConnectFunc, {name, length, ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("unix-listen", [=](){
+            auto length = stack::Pop();
+            auto name = stack::PopPtr(core::StrType);
+            stack::Push(core::CallFunction(util::UnixListenFunc, {name, length, ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("unix-accept", [=](){
+            stack::Push(core::CallFunction(util::UnixAcceptFunc, {stack::Pop(), ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("watch", [](){
+            auto flags = stack::Pop();
+            auto file = stack::Pop();
+            stack::Push(core::CallFunction(util::EventWatchFunc, {file, flags}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("unwatch", [](){
+            stack::Push(core::CallFunction(util::EventUnwatchFunc, {stack::Pop()}));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("event-wait", [=](){
+            stack::Push(core::CallFunction(util::EventWaitFunc, {stack::Pop(), ior}));
+            stack::Push(core::Builder.CreateLoad(ior));
+            CreateBrNext();
+        });
+        dict::AddNativeWord("event@", [=](){
+            stack::Push(core::CallFunction(util::EventGetFunc, {stack::Pop(), events}));
+            stack::Push(core::Builder.CreateLoad(events));
+            CreateBrNext();
+        });
+        auto task_word = dict::AddNativeWord("task", [](){
+            task::Create("i_task", stack::Pop());
+        });
+        dict::AddNativeWord("pause", [](){
+            task::Switch("i_pause");
+        });
+        dict::AddNativeWord("stop", [](){
+            task::SetState(task::GetCurrent(), task::Stopped);
+            task::Switch("i_stop");
+        });
+        dict::AddNativeWord("wake", [](){
+            task::Wake(stack::Pop());
+            CreateBrNext();
+        });
+        TaskEnd = dict::AddNativeWord("task-end", [](){
+            task::SetState(task::GetCurrent(), task::Free);
+            task::Switch("i_task-end");
+        });
+        Execute = dict::AddNativeWord("execute", [](){
             auto xt = stack::PopPtr(dict::XtPtrType);
             core::Builder.CreateStore(xt, engine::W);
             engine::Jump();
         });
+        // The outer interpreter over the rest of the current line, ending like word does at a newline
+        // or the end of input. Compiling words and numbers stays in the loop; to execute a word it
+        // rewinds pc onto its own cell, so it must be called from a colon body and not by execute.
+        dict::AddNativeWord("interpret", [=](){
+            auto loop = core::CreateBasicBlock("i_interpret_loop", engine::MainFunction);
+            auto empty = core::CreateBasicBlock("i_interpret_empty", engine::MainFunction);
+            auto failed = core::CreateBasicBlock("i_interpret_failed", engine::MainFunction);
+            auto end = core::CreateBasicBlock("i_interpret_end", engine::MainFunction);
+            auto lookup = core::CreateBasicBlock("i_interpret_lookup", engine::MainFunction);
+            auto found = core::CreateBasicBlock("i_interpret_found", engine::MainFunction);
+            auto execute = core::CreateBasicBlock("i_interpret_execute", engine::MainFunction);
+            auto compile = core::CreateBasicBlock("i_interpret_compile", engine::MainFunction);
+            auto number = core::CreateBasicBlock("i_interpret_number", engine::MainFunction);
+            auto float_number = core::CreateBasicBlock("i_interpret_float", engine::MainFunction);
+            auto push_float = core::CreateBasicBlock("i_interpret_push_float", engine::MainFunction);
+            auto compile_float = core::CreateBasicBlock("i_interpret_compile_float", engine::MainFunction);
+            auto integer = core::CreateBasicBlock("i_interpret_integer", engine::MainFunction);
+            auto push_integer = core::CreateBasicBlock("i_interpret_push_integer", engine::MainFunction);
+            auto compile_integer = core::CreateBasicBlock("i_interpret_compile_integer", engine::MainFunction);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(loop);
+            auto inbuf = core::Builder.CreateGEP(InputBuffer, {core::GetIndex(0), core::GetIndex(0)});
+            auto length = core::CallFunction(util::ReadWordFromReaderFunc, {reader, inbuf, core::GetInt(1024)});
+            if (stats::Enabled) { stats::RecordToken(length); }
+            auto is_compiling = core::Builder.CreateICmpNE(core::Builder.CreateLoad(StateValue), core::GetInt(0));
+            core::Builder.CreateCondBr(core::Builder.CreateICmpSGT(length, core::GetInt(0)), lookup, empty);
+
+            core::Builder.SetInsertPoint(empty);
+            core::Builder.CreateCondBr(core::Builder.CreateICmpSLT(length, core::GetInt(0)), failed, end);
+
+            core::Builder.SetInsertPoint(failed);
+            stack::Push(length);
+            core::Builder.CreateBr(Throw.block);
+
+            core::Builder.SetInsertPoint(end);
+            CreateBrNext();
+
+            core::Builder.SetInsertPoint(lookup);
+            auto xt = core::CallFunction(util::FindXtCachedFunc, {inbuf, length});
+            core::Builder.CreateCondBr(core::Builder.CreateIsNull(xt), number, found);
+
+            core::Builder.SetInsertPoint(found);
+            auto is_immediate = dict::GetXtImmediate(xt);
+            auto is_compiled = core::Builder.CreateAnd(is_compiling, core::Builder.CreateNot(is_immediate));
+            core::Builder.CreateCondBr(is_compiled, compile, execute);
+
+            core::Builder.SetInsertPoint(execute);
+            auto pc = core::Builder.CreateLoad(engine::PC);
+            core::Builder.CreateStore(core::Builder.CreateGEP(pc, core::GetIndex(-1)), engine::PC);
+            core::Builder.CreateStore(xt, engine::W);
+            engine::Jump();
+
+            core::Builder.SetInsertPoint(compile);
+            CreateCompile("i_interpret_compile", xt);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(number);
+            auto float_value = core::CallFunction(util::StringToFloatFunc, {inbuf, length, flag});
+            auto is_float = core::Builder.CreateICmpNE(core::Builder.CreateLoad(flag), core::GetInt(0));
+            core::Builder.CreateCondBr(is_float, float_number, integer);
+
+            core::Builder.SetInsertPoint(float_number);
+            core::Builder.CreateCondBr(is_compiling, compile_float, push_float);
+
+            core::Builder.SetInsertPoint(push_float);
+            stack::FPush(float_value);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(compile_float);
+            dict::AppendWide(core::Builder.CreateBitCast(float_value, core::IntType), dict::RawCell, Flit.xt);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(integer);
+            auto int_value = core::CallFunction(util::StringToIntFunc, {inbuf, length});
+            core::Builder.CreateCondBr(is_compiling, compile_integer, push_integer);
+
+            core::Builder.SetInsertPoint(push_integer);
+            stack::Push(int_value);
+            core::Builder.CreateBr(loop);
+
+            core::Builder.SetInsertPoint(compile_integer);
+            CreateLiteral("i_interpret_literal", int_value);
+            core::Builder.CreateBr(loop);
+        });
+        task::SetEntry(dict::InitialMemory.size());
+        auto task_colon = dict::AddColonWord("(task)", Docol.addr, {Execute.xt, TaskEnd.xt});
+        dict::References[task_word.xt].push_back(task_colon.xt);
         dict::AddColonWord(":", Docol.addr, {
                 Inbuf.xt, Word.xt, Dup.xt,
                 Branch0.xt, 0,
@@ -369,7 +1048,7 @@ namespace words {
         });
         dict::AddColonWord(";", Docol.addr, {
                 Lit.xt, GetConstantIntToXtPtr(0), State.xt, Write.xt,
-                Lit.xt, Exit.xt, Comma.xt,
+                Lit.xt, Exit.xt, CompileComma.xt,
                 Exit.xt,
         }, true);
     };